@@ -0,0 +1,76 @@
+/*
+ * access_trace_format.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef ACCESS_TRACE_FORMAT_H
+#define ACCESS_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * Binary register access trace: one access_trace_header followed by fixed size
+ * access_trace_record, all in host byte order.
+ */
+#define ACCESS_TRACE_MAGIC "SCPUTRC"
+#define ACCESS_TRACE_VERSION 1
+
+typedef struct access_trace_header
+{
+  char magic[8];                /*<! ACCESS_TRACE_MAGIC, NUL terminated. */
+  uint32_t version;
+  uint32_t record_size;         /*<! sizeof(access_trace_record). */
+  uint64_t host_start_ns;       /*<! Host time when the trace was opened. */
+} access_trace_header;
+
+typedef struct access_trace_record
+{
+  uint64_t host_ns;             /*<! Host time when the access started. */
+  uint64_t sc_ps;               /*<! SystemC time of the access. */
+  uint64_t address;
+  uint64_t value;               /*<! The first 8 bytes of a burst. */
+  uint32_t latency_ns;          /*<! Host time spent in the access. */
+  uint16_t size;                /*<! Saturated at 0xFFFF. */
+  uint8_t is_write;
+  uint8_t posted;
+} access_trace_record;
+
+#endif /* !ACCESS_TRACE_FORMAT_H */
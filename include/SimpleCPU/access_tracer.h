@@ -0,0 +1,117 @@
+/*
+ * access_tracer.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef ACCESS_TRACER_H
+#define ACCESS_TRACER_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string>
+#include "SimpleCPU/access_trace_format.h"
+#include "SimpleCPU/spsc_ring.h"
+#include "SimpleCPU/sync_semaphore.h"
+
+/*
+ * Register access tracer. The CPU thread drops records in a lock-free ring and
+ * a background thread writes them to the trace file. Records which don't fit
+ * in the ring are counted and dropped rather than stalling the CPU.
+ */
+class access_tracer
+{
+  public:
+  access_tracer();
+  ~access_tracer();
+  bool open(const std::string& path);
+  void close();
+  void set_filter(uint64_t start, uint64_t end);
+  void set_sampling(uint32_t one_in_n);
+  uint64_t get_dropped() const;
+
+  /* Producer side, CPU thread only. */
+  bool wants(uint64_t address)
+  {
+    if (address < filter_start || address > filter_end)
+    {
+      return false;
+    }
+    if (++sample_count < sample_period)
+    {
+      return false;
+    }
+    sample_count = 0;
+    return true;
+  }
+  void record(const access_trace_record& record)
+  {
+    if (!ring.push(record))
+    {
+      __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+    }
+    /* The writer sleeps until there is a batch worth writing. */
+    if (ring.count() >= high_water
+        && !__atomic_exchange_n(&wake_pending, true, __ATOMIC_SEQ_CST))
+    {
+      writer_wakeup.post();
+    }
+  }
+
+  private:
+  static const uint32_t ring_size = 4096;
+  static const uint32_t high_water = ring_size / 2;
+  spsc_ring<access_trace_record, ring_size> ring;
+  uint64_t filter_start;
+  uint64_t filter_end;
+  uint32_t sample_period;
+  uint32_t sample_count;
+  uint64_t dropped;
+
+  FILE *file;
+  pthread_t writer;
+  bool running;
+  sync_semaphore writer_wakeup;
+  bool wake_pending;            /*<! writer_wakeup posted, not drained yet. */
+  static void *writer_thread(void *opaque);
+  void drain();
+};
+
+#endif /* !ACCESS_TRACER_H */
@@ -0,0 +1,120 @@
+/*
+ * checkpoint.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * Checkpoint image: the header, the region table, the pending notifications,
+ * the model blob and then the content of each region. Region contents are page
+ * aligned in the file so a restore can map them copy on write over the DMI
+ * memory.
+ */
+#define CHECKPOINT_MAGIC "SCPUCKP"
+#define CHECKPOINT_VERSION 2
+
+typedef struct checkpoint_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t region_count;
+  uint64_t page_size;                 /*<! Alignment of the region data. */
+  uint64_t time_ns;                   /*<! Time seen by the model. */
+  uint64_t quantum_ns;                /*<! Length of the next quantum. */
+  uint64_t notification_count;        /*<! ns until each one, uint64_t. */
+  uint64_t model_offset;
+  uint64_t model_size;
+} checkpoint_header;
+
+typedef struct checkpoint_region
+{
+  uint64_t start;
+  uint64_t end;                       /*<! Inclusive. */
+  uint64_t offset;                    /*<! Of the data in the file. */
+} checkpoint_region;
+
+class checkpoint_writer
+{
+  public:
+  checkpoint_writer();
+  /* data must stay valid until write() returns. */
+  void add_region(uint64_t start, uint64_t end, const uint8_t *data);
+  /* Only the time and quantum fields of state are used. */
+  bool write(const std::string& path, const checkpoint_header& state,
+             const std::vector<uint8_t>& model,
+             const std::vector<uint64_t>& notifications);
+
+  private:
+  std::vector<checkpoint_region> regions;
+  std::vector<const uint8_t *> data;
+};
+
+class checkpoint_image
+{
+  public:
+  checkpoint_image();
+  ~checkpoint_image();
+  bool open(const std::string& path);
+  const checkpoint_header& header() const;
+  const checkpoint_region& region(uint32_t index) const;
+  const uint8_t *model() const;
+  const uint64_t *notifications() const;
+  /*
+   * Put the content of a region at host. With cow the file is mapped over host
+   * when the alignment allows it so the pages are only copied when written:
+   * host must then be private anonymous memory, the mapping replaces it.
+   */
+  bool restore_region(uint32_t index, uint8_t *host, bool cow) const;
+
+  private:
+  uint8_t *image;
+  size_t size;
+  int fd;
+};
+
+#endif /* !CHECKPOINT_H */
@@ -0,0 +1,104 @@
+/*
+ * dmi_table.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef DMI_TABLE_H
+#define DMI_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include <systemc>
+
+/*
+ * One range granted (or refused) by the interconnect, start and end are
+ * inclusive like in tlm::tlm_dmi.
+ */
+typedef struct dmi_region
+{
+  uint64_t start;
+  uint64_t end;
+  uint8_t *pointer;             /*<! Host address of start, NULL if refused. */
+  bool read_allowed;
+  bool write_allowed;
+  sc_core::sc_time read_latency;
+  sc_core::sc_time write_latency;
+
+  bool contains(uint64_t address, uint64_t size) const
+  {
+    return (address >= start) && (address <= end)
+        && (size - 1 <= end - address);
+  }
+} dmi_region;
+
+typedef struct dmi_range
+{
+  uint64_t start;
+  uint64_t end;
+} dmi_range;
+
+/*
+ * Add [start, end] to a sorted list of ranges, merging every range it
+ * overlaps or touches.
+ */
+void dmi_range_merge(std::vector<dmi_range>& ranges, uint64_t start,
+                     uint64_t end);
+
+/*
+ * Sorted, non overlapping set of DMI regions. Only used by the CPU thread.
+ */
+class dmi_table
+{
+  public:
+  dmi_table();
+  const dmi_region *lookup(uint64_t address);
+  void insert(const dmi_region& region);
+  void invalidate(uint64_t start, uint64_t end);
+  void clear();
+  size_t count() const;
+  const dmi_region& at(size_t index) const;
+
+  private:
+  std::vector<dmi_region> regions;
+  size_t last_hit;              /*<! Index of the last region found. */
+};
+
+#endif /* !DMI_TABLE_H */
@@ -0,0 +1,117 @@
+/*
+ * irq_coalescer.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef IRQ_COALESCER_H
+#define IRQ_COALESCER_H
+
+#include <stdint.h>
+
+/*
+ * IRQ front-end. SystemC records the line levels in an atomic bitmap and the
+ * CPU thread delivers the net changes in one batch at its next safe point. A
+ * line toggled an even number of times in between isn't delivered at all:
+ * this is for level sensitive lines, lines which can't lose a pulse must be
+ * marked immediate.
+ */
+class irq_coalescer
+{
+  public:
+  static const uint32_t line_count = 1024;
+
+  irq_coalescer();
+  /* Lines delivered right away by the caller instead of batched. */
+  void set_immediate(uint32_t line);
+  bool is_immediate(uint32_t line) const
+  {
+    return (line >= line_count)
+        || (immediate[line / 64] & ((uint64_t)1 << (line % 64)));
+  }
+
+  /* Producer, any thread. The line must not be immediate. */
+  void set_level(uint32_t line, bool level)
+  {
+    uint64_t mask = (uint64_t)1 << (line % 64);
+    uint64_t old;
+
+    __atomic_add_fetch(&edges, 1, __ATOMIC_RELAXED);
+    if (level)
+    {
+      old = __atomic_fetch_or(&levels[line / 64], mask, __ATOMIC_ACQ_REL);
+    }
+    else
+    {
+      old = __atomic_fetch_and(&levels[line / 64], ~mask, __ATOMIC_ACQ_REL);
+    }
+    if (!(old & mask) == !level)
+    {
+      /* Same level again: nothing to deliver. */
+      return;
+    }
+    /* Two toggles cancel each other out. */
+    __atomic_fetch_xor(&changed[line / 64], mask, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+  }
+
+  /* Consumer, the CPU thread. */
+  bool has_pending() const
+  {
+    return __atomic_load_n(&pending, __ATOMIC_ACQUIRE);
+  }
+  typedef void (*deliver_fn)(void *opaque, uint32_t line, bool level);
+  /* Deliver every line which changed, returns how many. */
+  uint32_t drain(deliver_fn deliver, void *opaque);
+
+  uint64_t get_edges() const;
+  uint64_t get_deliveries() const;
+
+  private:
+  static const uint32_t words = line_count / 64;
+  uint64_t levels[words];
+  uint64_t changed[words];            /*<! Lines to deliver. */
+  uint64_t immediate[words];          /*<! Set during elaboration only. */
+  bool pending;                       /*<! Some changed bit may be set. */
+  uint64_t edges;
+  uint64_t deliveries;
+};
+
+#endif /* !IRQ_COALESCER_H */
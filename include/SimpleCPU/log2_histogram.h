@@ -0,0 +1,91 @@
+/*
+ * log2_histogram.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef LOG2_HISTOGRAM_H
+#define LOG2_HISTOGRAM_H
+
+#include <stdint.h>
+#include <ostream>
+
+/*
+ * Histogram with one bucket per power of two: bucket 0 counts the zeros and
+ * bucket n the values in [2^(n-1), 2^n). Adding a value is a few instructions
+ * so it can be used on the access paths.
+ */
+class log2_histogram
+{
+  public:
+  static const unsigned int bucket_count = 65;
+
+  log2_histogram();
+  void add(uint64_t value)
+  {
+    buckets[value ? 64 - __builtin_clzll(value) : 0]++;
+    samples++;
+    total += value;
+    if (value > maximum)
+    {
+      maximum = value;
+    }
+  }
+  void merge(const log2_histogram& other);
+  void clear();
+
+  uint64_t count() const { return samples; }
+  uint64_t sum() const { return total; }
+  uint64_t max() const { return maximum; }
+  uint64_t mean() const { return samples ? total / samples : 0; }
+  uint64_t bucket(unsigned int n) const { return buckets[n]; }
+  /* Upper bound of the bucket holding the given percentile. */
+  uint64_t percentile(unsigned int percent) const;
+  /* One "[low, high) count" line per non empty bucket. */
+  void print(std::ostream& os, const char *prefix) const;
+
+  private:
+  uint64_t buckets[bucket_count];
+  uint64_t samples;
+  uint64_t total;
+  uint64_t maximum;
+};
+
+#endif /* !LOG2_HISTOGRAM_H */
@@ -0,0 +1,138 @@
+/*
+ * mmio_profiler.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef MMIO_PROFILER_H
+#define MMIO_PROFILER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+#include "SimpleCPU/dmi_table.h"
+#include "SimpleCPU/log2_histogram.h"
+
+/* The path an access took in memory_bt. */
+enum mmio_route
+{
+  MMIO_ROUTE_DMI = 0,
+  MMIO_ROUTE_FPGA,
+  MMIO_ROUTE_TRANSACTION,
+  MMIO_ROUTE_COUNT
+};
+
+struct mmio_route_stats
+{
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t bytes;
+  log2_histogram host_ns;             /*<! Host time of each access. */
+  log2_histogram sc_ps;               /*<! SystemC time of each access. */
+};
+
+/*
+ * Per address region access statistics. An address is accounted to the
+ * configured region holding it, else to its page. Only the CPU thread records
+ * accesses; a report can be produced from any thread at any time, the
+ * counters being read while they move.
+ */
+class mmio_profiler
+{
+  public:
+  mmio_profiler(unsigned int page_shift);
+  ~mmio_profiler();
+  /*
+   * Must be called before the first access is recorded. false, and nothing
+   * added, when it overlaps a region added before.
+   */
+  bool add_region(uint64_t start, uint64_t end);
+
+  void record(uint64_t address, uint64_t size, bool is_write,
+              mmio_route route, uint64_t host_ns, uint64_t sc_ps)
+  {
+    mmio_route_stats *stats;
+
+    if (!last || address < last->start || address > last->end)
+    {
+      last = this->lookup(address);
+    }
+    stats = &last->routes[route];
+    if (is_write)
+    {
+      stats->writes++;
+    }
+    else
+    {
+      stats->reads++;
+    }
+    stats->bytes += size;
+    stats->host_ns.add(host_ns);
+    stats->sc_ps.add(sc_ps);
+  }
+
+  /* Busiest regions first. */
+  void report(std::ostream& os, bool histograms) const;
+
+  private:
+  struct entry
+  {
+    uint64_t start;
+    uint64_t end;
+    mmio_route_stats routes[MMIO_ROUTE_COUNT];
+  };
+  unsigned int page_shift;
+  std::vector<dmi_range> regions;     /*<! Sorted, not overlapping. */
+  /*
+   * Open addressing on the region start. Entries never move once created so
+   * last stays valid when the table grows.
+   */
+  entry **table;
+  uint32_t table_bits;
+  uint32_t used;
+  entry *last;
+  mutable pthread_mutex_t mtx;        /*<! Table growth against report. */
+  entry *lookup(uint64_t address);
+  uint32_t slot_of(uint64_t start) const;
+  void grow();
+};
+
+#endif /* !MMIO_PROFILER_H */
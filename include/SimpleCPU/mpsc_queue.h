@@ -0,0 +1,139 @@
+/*
+ * mpsc_queue.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdint.h>
+#include "SimpleCPU/spsc_ring.h"
+
+/*
+ * Lock-free bounded multiple producer / single consumer queue.
+ *
+ * Every slot carries a sequence number telling whose turn it is: producers
+ * claim a position with a compare and swap on tail and publish the slot by
+ * moving its sequence, so a slot is never read before it is complete. N must
+ * be a power of 2.
+ */
+template <typename T, uint32_t N>
+class mpsc_queue
+{
+  public:
+  mpsc_queue():
+    head(0),
+    tail(0)
+  {
+    for (uint32_t i = 0; i < N; i++)
+    {
+      slots[i].sequence = i;
+    }
+  }
+
+  /* Producer side, any thread. False when the queue is full. */
+  bool push(const T& item)
+  {
+    uint32_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    slot *s;
+
+    while (true)
+    {
+      s = &slots[position & (N - 1)];
+      int32_t diff = (int32_t)(__atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)
+                               - position);
+      if (diff == 0)
+      {
+        if (__atomic_compare_exchange_n(&tail, &position, position + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+      }
+    }
+
+    s->item = item;
+    __atomic_store_n(&s->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /* Consumer side. */
+  bool pop(T& item)
+  {
+    slot *s = &slots[head & (N - 1)];
+
+    if (__atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE) != head + 1)
+    {
+      return false;
+    }
+    item = s->item;
+    /* Hand the slot to the producers of the next lap. */
+    __atomic_store_n(&s->sequence, head + N, __ATOMIC_RELEASE);
+    head++;
+    return true;
+  }
+
+  private:
+  typedef char size_must_be_a_power_of_two[(N & (N - 1)) == 0 ? 1 : -1];
+
+  struct slot
+  {
+    uint32_t sequence;
+    T item;
+  };
+
+  uint32_t head;
+  char consumer_pad[SPSC_RING_CACHE_LINE - sizeof(uint32_t)];
+  uint32_t tail;
+  char producer_pad[SPSC_RING_CACHE_LINE - sizeof(uint32_t)];
+
+  slot slots[N];
+};
+
+#endif /* !MPSC_QUEUE_H */
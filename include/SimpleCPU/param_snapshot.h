@@ -0,0 +1,117 @@
+/*
+ * param_snapshot.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+#ifndef PARAM_SNAPSHOT_H
+#define PARAM_SNAPSHOT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "greencontrol/config.h"
+
+/*
+ * Copy of the GreenControl parameters the tlm2c model reads, so it can read
+ * them in its main loop without a lookup in GreenControl and a strdup() per
+ * call. A parameter is copied, and watched, the first time the model asks for
+ * it.
+ *
+ * The strings handed out are owned by the snapshot and stay valid until it is
+ * destroyed: when a parameter is written its entry is only invalidated and
+ * refreshed on the next read. Values are interned, so the old string is still
+ * there for who borrowed it and a value read again costs no memory.
+ * Every method can be called from any thread.
+ */
+class param_snapshot
+{
+  GC_HAS_CALLBACKS();
+  public:
+  param_snapshot();
+  ~param_snapshot();
+  /* Start answering: called at elaboration, before the model reads. */
+  void enable();
+
+  /* NULL if the parameter doesn't exist. */
+  const char *get_string(const char *name);
+  bool get_uint(const char *name, uint64_t *value);
+  bool get_int(const char *name, int64_t *value);
+  /*
+   * Borrowed names and values of the parameters starting with prefix, at most
+   * max of them. Returns how many match.
+   */
+  size_t get_all(const char *prefix, const char **names,
+                 const char **values, size_t max);
+  /* Names of every parameter in GreenControl, none of them is copied. */
+  std::vector<std::string> names();
+
+  private:
+  struct entry
+  {
+    std::string name;
+    gs::gs_param_base *par;
+    const char *value;          /*<! NULL when stale. */
+    bool has_uint;
+    bool has_int;
+    uint64_t uint_value;
+    int64_t int_value;
+  };
+  entry **table;                /*<! Open addressing on the name hash. */
+  uint32_t table_bits;
+  std::vector<entry *> entries; /*<! Creation order. */
+  std::set<std::string> strings; /*<! Every value ever handed out. */
+  pthread_mutex_t mtx;
+  bool enabled;
+
+  entry *find(const char *name) const;
+  entry *lookup(const char *name);
+  entry *add(gs::gs_param_base *par);
+  void watch(gs::gs_param_base *par);
+  const char *value_of(entry *e);
+  void grow();
+  gs::cnf::callback_return_type param_changed(gs::gs_param_base& par,
+                                              gs::cnf::callback_type reason);
+};
+
+#endif /* !PARAM_SNAPSHOT_H */
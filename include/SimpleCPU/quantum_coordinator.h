@@ -0,0 +1,135 @@
+/*
+ * quantum_coordinator.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef QUANTUM_COORDINATOR_H
+#define QUANTUM_COORDINATOR_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <systemc>
+#include "SimpleCPU/sync_semaphore.h"
+
+/*
+ * A CPU taking part in the shared quantum. Every method is called from the
+ * SystemC thread.
+ */
+class quantum_member
+{
+  public:
+  virtual ~quantum_member() {}
+  /* Block until the CPU thread has started, once before the first barrier. */
+  virtual void wait_for_start() = 0;
+  /* The CPU has requests do_io() hasn't drained yet. */
+  virtual bool io_pending() = 0;
+  /* Release the CPU for its next quantum. */
+  virtual void start_quantum() = 0;
+};
+
+/*
+ * Runs the quantum of several CPUs together. They all start their quantum at
+ * the same time and run on their own threads, SystemC meanwhile services the
+ * IO of every one of them. At the end of the quantum the barrier waits until
+ * every CPU has finished before releasing them all again.
+ *
+ * All the CPUs ring the same doorbell, so SystemC only ever sleeps in one
+ * place and wakes up whichever CPU needs it.
+ *
+ * CPUs share a coordinator by group name. It belongs to its members: the last
+ * one to leave() deletes it, so the next elaboration starts afresh.
+ */
+class quantum_coordinator
+{
+  public:
+  /* The coordinator of group, created by the first CPU joining it. */
+  static quantum_coordinator *join(const std::string& group,
+                                   quantum_member *member,
+                                   uint64_t quantum_ns, wait_policy policy,
+                                   uint32_t spin_count);
+  /* The member is being destroyed. */
+  void leave(quantum_member *member);
+
+  /* CPU thread. */
+  void wake_up_systemc()
+  {
+    doorbell.post();
+  }
+  void cpu_finished()
+  {
+    __atomic_add_fetch(&finished, 1, __ATOMIC_SEQ_CST);
+    doorbell.post();
+  }
+  /* Give the SystemC kernel back even if the barrier isn't done. */
+  void interrupt()
+  {
+    __atomic_store_n(&interrupted, true, __ATOMIC_SEQ_CST);
+    doorbell.post();
+  }
+
+  /* SystemC thread. */
+  bool at_barrier() const
+  {
+    return waiting;
+  }
+  void recheck();                     /*<! IO done, re-run the barrier. */
+  void consume_wakeups();             /*<! Drop the doorbell rings. */
+  uint64_t get_quantum() const;
+
+  private:
+  quantum_coordinator(const std::string& group, uint64_t quantum_ns);
+  ~quantum_coordinator();
+  static std::map<std::string, quantum_coordinator *> groups;
+  std::string group;
+  std::vector<quantum_member *> members;
+  sync_semaphore doorbell;
+  uint32_t finished;                  /*<! CPUs done with this quantum. */
+  bool waiting;                       /*<! The barrier is waiting. */
+  bool interrupted;
+  bool started;
+  uint64_t quantum;
+  sc_core::sc_event barrier_evt;
+  void barrier();
+};
+
+#endif /* !QUANTUM_COORDINATOR_H */
@@ -0,0 +1,144 @@
+/*
+ * register_backend.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef REGISTER_BACKEND_H
+#define REGISTER_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#if AWS_FPGA_PRESENT
+#include "fpga_pci.h"
+#endif
+
+/*
+ * Register window reached directly by the CPU thread (the "FPGA" route of
+ * memory_bt). Every call returns 0 on success, like the fpga_pci calls.
+ *
+ * When combine_bytes is not zero, writes to consecutive addresses inside one
+ * of the ranges given to add_combine_range() are gathered in a buffer and
+ * issued with the widest accesses possible when the buffer is full, when a
+ * write isn't contiguous, before any other access, or on flush(). Merging
+ * changes the accesses the device sees: only ranges without side effects, like
+ * memories, may be declared.
+ */
+class register_backend
+{
+  public:
+  register_backend(size_t combine_bytes);
+  virtual ~register_backend();
+  int write(uint64_t address, const uint8_t *data, size_t len);
+  int read(uint64_t address, uint8_t *data, size_t len);
+  int flush();
+  /* [start, end], both ends included. */
+  void add_combine_range(uint64_t start, uint64_t end);
+
+  protected:
+  /* One access of 1, 2, 4 or 8 bytes, naturally aligned. */
+  virtual int raw_write(uint64_t address, const uint8_t *data,
+                        size_t len) = 0;
+  virtual int raw_read(uint64_t address, uint8_t *data, size_t len) = 0;
+
+  private:
+  int split_write(uint64_t address, const uint8_t *data, size_t len);
+  int split_read(uint64_t address, uint8_t *data, size_t len);
+  bool combinable(uint64_t address, size_t len) const;
+  struct combine_range
+  {
+    uint64_t start;
+    uint64_t end;
+  };
+  std::vector<combine_range> combine_ranges;
+  uint8_t *combine_buffer;
+  size_t combine_size;
+  uint64_t combine_start;
+  size_t combine_len;
+};
+
+#if AWS_FPGA_PRESENT
+/*
+ * BAR of an AWS F1 FPGA.
+ */
+class aws_register_backend:
+  public register_backend
+{
+  public:
+  aws_register_backend(pci_bar_handle_t handle, size_t combine_bytes);
+
+  protected:
+  int raw_write(uint64_t address, const uint8_t *data, size_t len);
+  int raw_read(uint64_t address, uint8_t *data, size_t len);
+
+  private:
+  pci_bar_handle_t handle;
+};
+#endif
+
+#ifndef _WIN32
+/*
+ * A file or shared memory object mapped in place of the BAR, so the FPGA route
+ * can be run and measured on any Linux host. The address base maps to the
+ * start of the file.
+ */
+class mmap_register_backend:
+  public register_backend
+{
+  public:
+  mmap_register_backend(const std::string& path, uint64_t base, size_t size,
+                        size_t combine_bytes);
+  ~mmap_register_backend();
+  bool is_mapped() const;
+
+  protected:
+  int raw_write(uint64_t address, const uint8_t *data, size_t len);
+  int raw_read(uint64_t address, uint8_t *data, size_t len);
+
+  private:
+  volatile uint8_t *window;
+  uint64_t base;
+  size_t size;
+};
+#endif
+
+#endif /* !REGISTER_BACKEND_H */
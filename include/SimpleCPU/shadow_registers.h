@@ -0,0 +1,117 @@
+/*
+ * shadow_registers.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+#ifndef SHADOW_REGISTERS_H
+#define SHADOW_REGISTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum shadow_mode
+{
+  SHADOW_READ = 0,              /*<! Reads cached, writes invalidate. */
+  SHADOW_WRITE_THROUGH,         /*<! Writes update the copy and the target. */
+  SHADOW_WRITE_BACK             /*<! Writes update the copy, flushed later. */
+};
+
+/* A write held back by a SHADOW_WRITE_BACK range. */
+struct shadow_write
+{
+  uint64_t address;
+  uint8_t data[8];
+  uint32_t size;
+};
+
+/*
+ * Local copy of MMIO ranges declared free of read side effects, so the CPU
+ * thread can serve the reads without a transaction. Only the CPU thread uses
+ * it: invalidations requested by the targets reach it through the same queue
+ * as the DMI ones.
+ */
+class shadow_registers
+{
+  public:
+  /* Two bytes of copy per address: a range is at most that large. */
+  static const uint64_t max_range_size = 1 << 20;
+  /*
+   * Both ends are included. false, and nothing added, when it overlaps a
+   * range added before or is larger than max_range_size.
+   */
+  bool add_range(uint64_t start, uint64_t end, shadow_mode mode);
+  bool empty() const
+  {
+    return ranges.empty();
+  }
+
+  /* True with the data when every byte of the access is known. */
+  bool read(uint64_t address, uint8_t *data, size_t size);
+  /* Keep the data a transaction read. */
+  void fill(uint64_t address, const uint8_t *data, size_t size);
+  /* False when the write must still be sent to the target. */
+  bool write(uint64_t address, const uint8_t *data, size_t size);
+  /* Forget the clean bytes in [start, end]: the target changed them. */
+  void invalidate(uint64_t start, uint64_t end);
+  /* The writes held back, in order, the copy is clean afterwards. */
+  void take_dirty(std::vector<shadow_write>& writes);
+  bool is_dirty() const
+  {
+    return !dirty.empty();
+  }
+
+  private:
+  struct range
+  {
+    uint64_t start;
+    uint64_t end;
+    shadow_mode mode;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> state; /*<! Per byte: SHADOW_VALID | SHADOW_DIRTY. */
+  };
+  std::vector<range> ranges;    /*<! Sorted by start. */
+  std::vector<shadow_write> dirty;
+  range *lookup(uint64_t address, size_t size);
+};
+
+#endif /* !SHADOW_REGISTERS_H */
@@ -41,34 +41,41 @@
  */
 
 #include <pthread.h>
+#include <deque>
+#include <map>
 #include <systemc.h>
 #include "tlm2CSCBridge.h"
 #include "SimpleCPU/thread_safe_event.h"
+#include "SimpleCPU/spsc_ring.h"
+#include "SimpleCPU/sync_semaphore.h"
+#include "SimpleCPU/dmi_table.h"
 
 #include "greencontrol/config.h"
 #include "gsgpsocket/transport/GSGPMasterBlockingSocket.h"
 #include "gsgpsocket/transport/GSGPSlaveSocket.h"
 #include "gsgpsocket/transport/GSGPconfig.h"
 #include "greensignalsocket/green_signal.h"
-#if AWS_FPGA_PRESENT
-#include "fpga_pci.h"
-#endif
+#include "SimpleCPU/register_backend.h"
+#include "SimpleCPU/access_tracer.h"
+#include "SimpleCPU/mmio_profiler.h"
+#include "SimpleCPU/sync_stats.h"
+#include "SimpleCPU/checkpoint.h"
+#include "SimpleCPU/quantum_coordinator.h"
+#include "SimpleCPU/irq_coalescer.h"
+#include "SimpleCPU/shadow_registers.h"
+#include "SimpleCPU/traffic_record.h"
+#include "SimpleCPU/host_time.h"
 #ifndef SC_INCLUDE_DYNAMIC_PROCESSES
 #define SC_INCLUDE_DYNAMIC_PROCESSES
 #endif
 
-#if REGISTER_ACCESS_TRACE
-#include <iomanip>
-#include <iostream>
-#include <fstream>
-#include <time.h>
-#endif
-
 class SimpleCPU:
   public TLM2CSCBridge,
-  public gs::payload_event_queue_output_if<gs::gp::master_atom>
+  public gs::payload_event_queue_output_if<gs::gp::master_atom>,
+  public quantum_member
 {
   SC_HAS_PROCESS(SimpleCPU);
+  GC_HAS_CALLBACKS();
   public:
   SimpleCPU(sc_core::sc_module_name name);
   ~SimpleCPU();
@@ -81,11 +88,42 @@ class SimpleCPU:
                        sc_core::sc_time& time);
 
   void memory_bt(Payload *p);
+  ResponseStatus memory_burst(Command cmd, uint64_t address, uint8_t *data,
+                              size_t len);
+  void memory_issue(Command cmd, uint64_t address, uint8_t *data, size_t len,
+                    uint64_t tag);
+  int memory_collect(uint64_t *tag, ResponseStatus *status, bool wait);
   int memory_get_direct_mem_ptr(Payload *p, DMIData *d);
   void set_dmi_mutex(pthread_mutex_t *mtx, bool is_fpga);//wrapper for cmod and fpga
   void set_dmi_mutex(pthread_mutex_t *mtx);//cmod function
   void set_dmi_mutex_fpga(pthread_mutex_t *mtx);//fpga function
   void set_dmi_base_addr(uint64_t addr);
+  /*
+   * With dmi_sync = "atomic" the CPU doesn't take the DMI mutex for aligned
+   * accesses. The other side must bracket its bulk updates of the DMI memory
+   * with these two calls (they take the DMI mutex if one was set).
+   */
+  void dmi_write_begin();
+  void dmi_write_end();
+  /*
+   * Any thread: the target changed [start, end] behind the shadow registers.
+   * It goes through the DMI invalidation queue, so any DMI of the range is
+   * dropped as well.
+   */
+  void invalidate_registers(uint64_t start, uint64_t end);
+  /* Posted writes which completed with an error. */
+  typedef void (*posted_write_error_cb)(void *opaque, uint64_t address,
+                                        ResponseStatus status);
+  void set_posted_write_error_callback(posted_write_error_cb cb,
+                                       void *opaque);
+  uint64_t get_posted_write_errors() const;
+  /* MMIO profile report, when profile is set. */
+  void dump_profile(std::ostream& os, bool histograms);
+  /* CPU <-> SystemC handoff statistics, NULL unless sync_stats is set. */
+  const sync_stats *get_sync_stats() const;
+  void dump_sync_stats(std::ostream& os);
+  /* Checkpoint at the next quantum boundary, SystemC thread only. */
+  void request_checkpoint(const std::string& path);
 #if AWS_FPGA_PRESENT
   bool set_pci_bar_handle(pci_bar_handle_t pci_bar_handle_in);
 #endif
@@ -95,6 +133,8 @@ class SimpleCPU:
    */
   TargetSocket *targetSocket;
   InitiatorSocket *initiatorSocket;
+  GenericPayload *irq_payload;        /*<! Reused for every IRQ edge. */
+  GenericPayload *irq_batch_payload;  /*<! Used by the CPU thread. */
 
   void additional_init();
 
@@ -112,54 +152,208 @@ class SimpleCPU:
   gs::gs_param<std::string> extraArguments;
 
   /* Transaction posting mechanism. */
-  transactionHandle transaction;      /*<! Transaction to be posted. */
-  bool transaction_pending;           /*<! CPU is waiting SystemC for a txn. */
-  void post_a_transaction();
+  struct io_request
+  {
+    uint64_t address;
+    uint64_t value;                   /*<! Data for the access. */
+    uint8_t *data;                    /*<! Burst buffer, NULL: use value. */
+    uint32_t size;
+    Command cmd;
+    bool posted;                      /*<! Nobody waits for the response. */
+    uint64_t local_ps;                /*<! CPU local time, 0: not decoupled. */
+    bool nb;                          /*<! Issued by memory_issue(). */
+    uint64_t tag;                     /*<! Handed back by memory_collect(). */
+    bool want_dmi;                    /*<! Ask for DMI around address too. */
+    bool dmi_only;                    /*<! No transaction, only want_dmi. */
+    bool traced;                      /*<! nb: traced when it retires. */
+    uint64_t start_ns;                /*<! nb: host time it was issued at. */
+  };
+  struct io_response
+  {
+    uint64_t address;
+    uint64_t value;                   /*<! Data read by the access. */
+    uint8_t *data;                    /*<! Burst buffer of the request. */
+    uint32_t size;
+    Command cmd;
+    ResponseStatus status;
+    bool posted;
+    uint64_t host_ns;                 /*<! Time spent in Transact(). */
+    uint64_t sc_ps;
+    uint64_t done_ps;                 /*<! SystemC time at completion. */
+    uint64_t time_ps;                 /*<! Duration, annotation included. */
+    bool nb;
+    uint64_t tag;
+    bool has_dmi;                     /*<! dmi was asked for by the request. */
+    dmi_region dmi;                   /*<! Granted or refused. */
+    uint32_t dmi_epoch;               /*<! dmi_invalidate_epoch before it. */
+    bool traced;
+    uint64_t start_ns;
+  };
+  static const uint32_t io_ring_size = 16;
+  spsc_ring<io_request, io_ring_size> io_requests;   /*<! CPU -> SystemC. */
+  spsc_ring<io_response, io_ring_size> io_responses; /*<! SystemC -> CPU. */
+  /*
+   * One transaction per ring slot, created once and recycled. Each one stays
+   * bound to the data buffer of its slot until a burst points it elsewhere.
+   */
+  struct io_pool_entry
+  {
+    transactionHandle transaction;
+    unsigned char *buffer;            /*<! Data currently bound. */
+    uint32_t size;
+  };
+  io_pool_entry io_pool[io_ring_size]; /*<! Used by do_io() only. */
+  transactionHandle bind_transaction(io_request *request);
+  void post_a_transaction(const io_request& request, io_response *response);
+  void queue_io(const io_request& request, uint32_t depth);
   void init_io();
-  void destroy_io();
-  pthread_mutex_t io_done_mtx;
-  pthread_cond_t io_done_cond;
-  bool io_completed;
-  void finish_io();
-  void wait_for_io_completion();
+  sync_semaphore io_done;             /*<! Counts the pending io_responses. */
+  void finish_io(const io_response& response);
+  void wait_for_io_completion(io_response *response);
+  void pop_io_response(io_response *response);
+  uint32_t io_outstanding;            /*<! Requests without a response yet. */
+  uint64_t io_announced;              /*<! Requests do_io() was notified of. */
+  uint64_t io_drained;                /*<! Requests done by do_io(). */
+  void announce_io(uint32_t count);
+  void retire_response(const io_response& response);
+  uint32_t nb_in_flight;              /*<! memory_issue() not completed. */
+  std::deque<io_response> nb_completions; /*<! Not collected yet. */
+
+  /* Posted writes. */
+  gs::gs_param<bool> posted_writes;
+  gs::gs_param<uint64_t> posted_write_depth;
+  uint32_t posted_depth;
+  uint32_t posted_unsent;             /*<! Posted but SystemC not woken. */
+  uint64_t posted_write_errors;
+  posted_write_error_cb posted_error_cb;
+  void *posted_error_opaque;
+  void post_a_write(const io_request& request);
+  void retire_posted_write(const io_response& response);
+  void flush_posted_writes();
+  void io_barrier();                  /*<! Every earlier write has landed. */
   void do_io();
   thread_safe_event io_evt;
 
   /* Synchronisation mechanism. */
-  int systemc_running;                /*<! false when SystemC sleep. */
+  gs::gs_param<std::string> wait_policy_name; /*<! "block" or "spin". */
+  gs::gs_param<uint64_t> wait_spin_count;     /*<! Pauses before sleeping. */
+  wait_policy sync_policy;
+  void init_wait_policy();
   void init_systemc_sleep();
   void wake_up_systemc();
   void systemc_sleep();
-  void destroy_systemc_sleep();
-  pthread_mutex_t sc_sleep_mtx;
-  pthread_cond_t sc_sleep_cond;
+  sync_semaphore systemc_wakeup;      /*<! Posted to wake SystemC up. */
   void quantum_notify();
   void end_of_quantum();
   sc_event quantum_evt;
   gs::gs_param<uint64_t> quantum;
+  /*
+   * Adaptive quantum: each quantum is resized from the IO and IRQs seen during
+   * the previous one, aiming at quantum_target_io of them per quantum.
+   */
+  gs::gs_param<bool> quantum_adaptive;
+  gs::gs_param<uint64_t> quantum_min;
+  gs::gs_param<uint64_t> quantum_max;
+  gs::gs_param<uint64_t> quantum_target_io;
+  uint64_t current_quantum;           /*<! Length of this quantum in ns. */
+  uint64_t quantum_io_count;          /*<! Transactions in this quantum. */
+  uint64_t quantum_irq_count;         /*<! IRQ edges in this quantum. */
+  uint64_t next_quantum();
+  gs::cnf::callback_return_type quantum_changed(gs::gs_param_base& par,
+                                                gs::cnf::callback_type reason);
+  /*
+   * Temporal decoupling: the CPU runs ahead of SystemC by local_offset_ps
+   * within its quantum. DMI latencies and transaction times add to it, the
+   * transactions carry it as their delay. Once it reaches the quantum length
+   * the quantum ends, in advance_time() only: the accesses are called from
+   * the model and can't block it there.
+   */
+  gs::gs_param<bool> temporal_decoupling;
+  bool decoupled;
+  uint64_t quantum_base_ps;           /*<! SystemC time the quantum began. */
+  uint64_t local_offset_ps;           /*<! CPU thread only. */
+  bool quantum_expired;               /*<! CPU thread only. */
+  pthread_t cpu_thread;               /*<! Set by the first end_of_quantum(). */
+  uint64_t local_time_ps() const
+  {
+    return quantum_base_ps + local_offset_ps;
+  }
+  uint64_t local_time_ns();
+  void advance_local_time(uint64_t time_ns);
+  void advance_local_time_ps(uint64_t time_ps);
   volatile bool cpu_has_finished;
   bool systemc_has_finished;
   bool cpu_init;                      /*<! CPU mutexes initialised. */
+  sync_semaphore cpu_started;         /*<! Posted once cpu_init is set. */
+  bool cpu_running;                   /*<! SystemC saw cpu_started. */
+  volatile bool cpu_stopped;          /*<! The CPU exits when woken up. */
+  /*
+   * Shared quantum: the CPUs with shared_quantum set and the same
+   * shared_quantum_group run their quanta together, driven by the
+   * coordinator instead of quantum_notify().
+   */
+  gs::gs_param<bool> shared_quantum;
+  gs::gs_param<std::string> shared_quantum_group;
+  quantum_coordinator *coordinator;   /*<! NULL: this CPU runs on its own. */
+  void init_shared_quantum();
+
+  /*
+   * IRQ coalescing: the edges are recorded by irq_b_transport() and the CPU
+   * delivers the net changes at its next access or quantum boundary.
+   */
+  gs::gs_param<bool> irq_coalesce;
+  gs::gs_param<std::string> irq_immediate; /*<! "line,first-last" lists. */
+  irq_coalescer *irq_front;           /*<! NULL: every edge is delivered. */
+  void init_irq();
+  void check_irqs()
+  {
+    if (irq_front && irq_front->has_pending())
+    {
+      irq_front->drain(deliver_irq, this);
+    }
+  }
+  static void deliver_irq(void *opaque, uint32_t line, bool level);
+
+  /*
+   * Shadow registers: "start:end:mode" lists of MMIO ranges the CPU thread
+   * keeps a copy of. The mode is "read" (reads cached, writes invalidate),
+   * "write-through" or "write-back" (writes held until the next barrier).
+   */
+  gs::gs_param<std::string> shadow_ranges;
+  shadow_registers *shadow;           /*<! NULL when no range is declared. */
+  void init_shadow();
+  void flush_shadow();
+  void shadow_barrier(Command cmd, uint64_t address, size_t len);
+  void wait_for_start();
+  bool io_pending();
+  void start_quantum();
   /* CPU sleep. */
   void init_cpu_sleep();
   void wake_up_cpu();
   void cpu_sleep();
-  void destroy_cpu_sleep();
-  int cpu_running;
-  pthread_mutex_t cpu_sleep_mtx;
-  pthread_cond_t cpu_sleep_cond;
+  sync_semaphore cpu_wakeup;          /*<! Posted to wake the CPU up. */
 
   // DMI
   void memory_invalidate_direct_mem_ptr(unsigned int index,
                                         sc_dt::uint64 start,
                                         sc_dt::uint64 end);
-#if AWS_FPGA_PRESENT
-  bool data_write(uint64_t addr, uint8_t *p_data, int len);
-  bool data_read(uint64_t addr, uint8_t *p_data, int len);
-#endif
-  bool DMIInvalidatePending;
-  uint64_t DMIInvalidateStart;
-  uint64_t DMIInvalidateEnd;
+  /*
+   * Invalidations are queued by SystemC and applied by the CPU thread the next
+   * time it checks the epoch: on every access and at quantum boundaries.
+   */
+  pthread_mutex_t dmi_invalidate_mtx;
+  std::vector<dmi_range> dmi_invalidations;   /*<! Protected by the mutex. */
+  uint32_t dmi_invalidate_epoch;              /*<! Bumped by SystemC. */
+  uint32_t dmi_applied_epoch;                 /*<! Last epoch applied. */
+  void check_dmi_invalidations()
+  {
+    if (__atomic_load_n(&dmi_invalidate_epoch, __ATOMIC_ACQUIRE)
+        != dmi_applied_epoch)
+    {
+      apply_dmi_invalidations();
+    }
+  }
+  void apply_dmi_invalidations();
 
   /* dummy event. */
   sc_event dummy_evt;
@@ -174,15 +368,129 @@ class SimpleCPU:
   pthread_mutex_t *dmi_mtx;
   bool is_dmi;
   bool is_dmi_fpga;
-  uint64_t dmi_base_addr;
-  uint64_t *ptr;
-#if AWS_FPGA_PRESENT
-  pci_bar_handle_t pci_bar_handle;
-#endif
+  uint64_t dmi_base_addr;             /*<! Start of the FPGA route. */
+  dmi_table dmi_regions;
+  static const uint64_t dmi_refusal_mask = 0xFFF;
+  /*
+   * get_direct_mem_ptr() is only called by the SystemC thread: the CPU asks
+   * for it with the transaction which missed, the region comes back with the
+   * response and the CPU thread caches it in dmi_regions.
+   */
+  dmi_region acquire_dmi_region(uint64_t address);
+  bool dmi_wanted(uint64_t address);
+  const dmi_region *dmi_lookup(uint64_t address, uint64_t size, Command cmd);
+  gs::gs_param<std::string> dmi_sync; /*<! "mutex" or "atomic". */
+  bool dmi_lock_free;
+  uint32_t dmi_seq;                   /*<! Odd during a bulk update. */
+  void dmi_copy_from(const uint8_t *host, uint8_t *data, uint64_t size);
+  void dmi_copy_to(uint8_t *host, const uint8_t *data, uint64_t size);
 
-#if REGISTER_ACCESS_TRACE
-  //this ofstream is used for generate perf time analysis report.
-  ofstream  fout;
-#endif
+  /* fpga route */
+  register_backend *fpga_backend;
+  gs::gs_param<std::string> fpga_backend_type; /*<! "aws" or "mmap". */
+  gs::gs_param<std::string> fpga_backend_file; /*<! File mapped by "mmap". */
+  gs::gs_param<uint64_t> fpga_backend_base;    /*<! Address of the file. */
+  gs::gs_param<uint64_t> fpga_backend_size;
+  gs::gs_param<uint64_t> fpga_write_combine;   /*<! Bytes, 0 to disable. */
+  /* "start-end,start-end": the only ranges where writes are combined. */
+  gs::gs_param<std::string> fpga_write_combine_ranges;
+  void init_fpga_backend();
+  void init_write_combine(register_backend *backend);
+
+  /* register access trace, decoded by trace_decode. */
+  access_tracer *tracer;              /*<! NULL when not tracing. */
+  gs::gs_param<std::string> trace_file;
+  gs::gs_param<uint64_t> trace_start; /*<! Traced address range. */
+  gs::gs_param<uint64_t> trace_end;
+  gs::gs_param<uint64_t> trace_sample; /*<! Trace one access in N. */
+  void init_tracer();
+  void trace_access(uint64_t address, uint64_t value, uint64_t size,
+                    Command cmd, bool posted, uint64_t start_ns);
+  void trace_burst(uint64_t address, const uint8_t *data, uint64_t size,
+                   Command cmd, uint64_t start_ns);
+
+  /* MMIO profiler. */
+  mmio_profiler *profiler;            /*<! NULL when not profiling. */
+  gs::gs_param<bool> profile;
+  gs::gs_param<uint64_t> profile_page_shift;
+  gs::gs_param<std::string> profile_regions; /*<! "start-end,start-end". */
+  gs::gs_param<std::string> profile_report;  /*<! Dumped at stop, "": cout. */
+  gs::gs_param<bool> profile_histograms;
+  void init_profiler();
+  void profile_access(uint64_t address, uint64_t size, Command cmd,
+                      mmio_route route, uint64_t start_ns, uint64_t sc_ps)
+  {
+    profiler->record(address, size, cmd == WRITE, route,
+                     host_time_ns() - start_ns, sc_ps);
+  }
+  void report_profile();
+
+  /* handoff statistics. */
+  sync_stats *handoff_stats;          /*<! NULL when not measuring. */
+  gs::gs_param<bool> sync_stats_enable;
+  gs::gs_param<std::string> sync_stats_report; /*<! Dumped at stop, "": cout. */
+  uint64_t quantum_start_ns;
+  uint64_t quantum_io_start_ns;       /*<! io_wait time at quantum start. */
+  uint64_t dmi_locked_ns;
+  void init_sync_stats();
+  void quantum_stats_begin();
+  void dmi_lock();
+  void dmi_unlock();
+  void report_sync_stats();
+
+  /*
+   * Checkpoint: taken at a quantum boundary, while the CPU waits in
+   * end_of_quantum(). It holds the DMI memory the CPU used, the model state
+   * and the bridge timing. A restore happens at the first boundary: the CPU
+   * parks in its first end_of_quantum() until then.
+   */
+  gs::gs_param<std::string> checkpoint_file;
+  gs::gs_param<uint64_t> checkpoint_at;       /*<! SystemC ns, ~0: never. */
+  gs::gs_param<bool> checkpoint_exit;         /*<! Stop once it is written. */
+  gs::gs_param<std::string> restore_file;
+  /*
+   * Map the image over the DMI memory instead of copying it. Only for targets
+   * whose memory is a private, page aligned, anonymous mapping: anything else,
+   * shared or file backed memory included, would be replaced under them.
+   */
+  gs::gs_param<bool> restore_cow;
+  std::string checkpoint_path;                /*<! Pending request or "". */
+  bool checkpoint_taken;                      /*<! checkpoint_at is done. */
+  bool restore_pending;                       /*<! restore_file not done. */
+  bool take_checkpoint();
+  void restore_at_boundary();
+  /*
+   * false: not written, tried again at the next boundary. Either it failed or
+   * notifications the checkpoint can't hold are pending.
+   */
+  bool write_checkpoint(const std::string& path);
+  void restore_checkpoint(const std::string& path);
+
+  /*
+   * Traffic recording: every access of the model, every IRQ edge and the
+   * quantum boundaries. With replay_file a driver thread plays a recording
+   * back through master_socket and no library is loaded.
+   */
+  gs::gs_param<std::string> record_file;
+  gs::gs_param<std::string> replay_file;
+  gs::gs_param<bool> replay_local;    /*<! Reissue DMI, FPGA, shadow ones. */
+  traffic_recorder *recorder;         /*<! NULL when not recording. */
+  traffic_reader *replay;             /*<! NULL unless replaying. */
+  std::map<uint32_t, bool> replay_irq_levels; /*<! Seen by irq_b_transport. */
+  sc_event replay_irq_evt;
+  void init_recording();
+  bool replaying() const;
+  uint64_t access_time_ps()
+  {
+    return decoupled ? this->local_time_ps()
+                     : sc_core::sc_time_stamp().value();
+  }
+  void record_access(Command cmd, uint64_t address, const uint8_t *data,
+                     uint64_t size, traffic_record_route route,
+                     ResponseStatus status, uint64_t sc_ps, uint8_t flags);
+  void record_event(traffic_record_kind kind, uint64_t address,
+                    uint64_t value, uint64_t sc_ps);
+  void replay_driver();
+  bool replay_irq_seen(const traffic_record& record);
 };
 
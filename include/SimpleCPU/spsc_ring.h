@@ -0,0 +1,174 @@
+/*
+ * spsc_ring.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPSC_RING_CACHE_LINE 64
+
+/*
+ * Lock-free single producer / single consumer ring.
+ *
+ * The producer owns tail and the consumer owns head, each on its own cache
+ * line. Slots are filled in place: the producer gets a slot with alloc(),
+ * fills it and makes it visible with publish(). The consumer gets the oldest
+ * slot with peek() and gives it back with release(). N must be a power of 2.
+ */
+template <typename T, uint32_t N>
+class spsc_ring
+{
+  public:
+  spsc_ring():
+    head(0),
+    cached_tail(0),
+    tail(0),
+    cached_head(0)
+  {
+  }
+
+  /* Producer side. */
+  T *alloc()
+  {
+    if (tail - cached_head == N)
+    {
+      cached_head = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+      if (tail - cached_head == N)
+      {
+        return NULL;
+      }
+    }
+    return &slots[tail & (N - 1)];
+  }
+
+  void publish()
+  {
+    __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  bool push(const T& item)
+  {
+    T *slot = alloc();
+
+    if (!slot)
+    {
+      return false;
+    }
+    *slot = item;
+    publish();
+    return true;
+  }
+
+  /* Consumer side. */
+  T *peek()
+  {
+    if (head == cached_tail)
+    {
+      cached_tail = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+      if (head == cached_tail)
+      {
+        return NULL;
+      }
+    }
+    return &slots[head & (N - 1)];
+  }
+
+  /* Position of a slot in the ring, stable for the life of the ring. */
+  uint32_t index_of(const T *slot) const
+  {
+    return slot - slots;
+  }
+
+  void release()
+  {
+    __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+  }
+
+  bool pop(T& item)
+  {
+    T *slot = peek();
+
+    if (!slot)
+    {
+      return false;
+    }
+    item = *slot;
+    release();
+    return true;
+  }
+
+  /* Either side, only a snapshot. */
+  uint32_t count() const
+  {
+    return __atomic_load_n(&tail, __ATOMIC_ACQUIRE)
+         - __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+  }
+
+  bool empty() const
+  {
+    return count() == 0;
+  }
+
+  static uint32_t capacity()
+  {
+    return N;
+  }
+
+  private:
+  typedef char size_must_be_a_power_of_two[(N & (N - 1)) == 0 ? 1 : -1];
+
+  /* Consumer cache line. */
+  uint32_t head;
+  uint32_t cached_tail;
+  char consumer_pad[SPSC_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+  /* Producer cache line. */
+  uint32_t tail;
+  uint32_t cached_head;
+  char producer_pad[SPSC_RING_CACHE_LINE - 2 * sizeof(uint32_t)];
+
+  T slots[N];
+};
+
+#endif /* !SPSC_RING_H */
@@ -0,0 +1,105 @@
+/*
+ * sync_semaphore.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef SYNC_SEMAPHORE_H
+#define SYNC_SEMAPHORE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include "SimpleCPU/sync_stats.h"
+
+/*
+ * How a thread waits for the other side.
+ */
+typedef enum
+{
+  WAIT_BLOCK,                   /*<! Go to sleep straight away. */
+  WAIT_SPIN                     /*<! Spin for a while then go to sleep. */
+} wait_policy;
+
+static inline void sync_cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/*
+ * Counting semaphore used for the CPU <-> SystemC handoff.
+ *
+ * post() is a single atomic add unless somebody sleeps. wait() spins for up to
+ * spin_count pauses when the policy is WAIT_SPIN and then sleeps on a futex
+ * (or on a condition variable where futexes are not available).
+ */
+class sync_semaphore
+{
+  public:
+  sync_semaphore(int initial = 0);
+  ~sync_semaphore();
+  void set_policy(wait_policy policy, uint32_t spin_count);
+  /* Account the waits in stats, NULL to stop. */
+  void set_stats(wait_point_stats *stats);
+  void post();
+  void wait();
+  bool try_wait();
+
+  static bool parse_policy(const std::string& name, wait_policy *policy);
+
+  private:
+  int count;                    /*<! Futex word. */
+  int waiters;                  /*<! Threads sleeping on count. */
+  wait_policy policy;
+  uint32_t spin_count;
+  wait_point_stats *stats;
+  void sleep(int value);
+  void wake();
+#ifndef __linux__
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+#endif
+};
+
+#endif /* !SYNC_SEMAPHORE_H */
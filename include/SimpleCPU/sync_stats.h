@@ -0,0 +1,101 @@
+/*
+ * sync_stats.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef SYNC_STATS_H
+#define SYNC_STATS_H
+
+#include <stdint.h>
+#include <ostream>
+#include "SimpleCPU/log2_histogram.h"
+
+/*
+ * Statistics of a point where a thread waits for the other side. Each one is
+ * only updated by the waiting thread.
+ */
+struct wait_point_stats
+{
+  uint64_t waits;
+  uint64_t immediate;                 /*<! Didn't wait at all. */
+  uint64_t spun;                      /*<! Satisfied while spinning. */
+  uint64_t wakeups;                   /*<! Returns from a sleep. */
+  uint64_t spurious;                  /*<! Wake-ups with nothing to take. */
+  log2_histogram blocked_ns;          /*<! Every wait which wasn't immediate. */
+
+  wait_point_stats();
+  void print(std::ostream& os, const char *name) const;
+};
+
+struct lock_stats
+{
+  uint64_t acquisitions;
+  uint64_t contended;                 /*<! The lock was held by somebody. */
+  log2_histogram wait_ns;             /*<! Contended acquisitions only. */
+  log2_histogram hold_ns;
+
+  lock_stats();
+  void print(std::ostream& os, const char *name) const;
+};
+
+/*
+ * CPU <-> SystemC handoff statistics. The counters are read while they move:
+ * a report taken during the simulation is only approximately consistent.
+ */
+struct sync_stats
+{
+  wait_point_stats cpu_sleep;         /*<! CPU waiting for the quantum end. */
+  wait_point_stats systemc_sleep;     /*<! SystemC waiting for the CPU. */
+  wait_point_stats io_wait;           /*<! CPU waiting for its IO. */
+  wait_point_stats cpu_init;          /*<! Waiting for the CPU start. */
+  lock_stats dmi_lock;                /*<! dmi_mtx taken by memory_bt. */
+
+  /* Host time of each quantum, from the CPU point of view. */
+  uint64_t quanta;
+  log2_histogram quantum_cpu_ns;      /*<! Running the CPU model. */
+  log2_histogram quantum_io_ns;       /*<! Waiting on IO. */
+  log2_histogram quantum_systemc_ns;  /*<! Letting SystemC finish. */
+
+  sync_stats();
+  void print(std::ostream& os) const;
+};
+
+#endif /* !SYNC_STATS_H */
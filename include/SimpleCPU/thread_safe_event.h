@@ -44,6 +44,9 @@
 #define THREAD_SAFE_EVENT_H
 
 #include <systemc.h>
+#include <deque>
+#include <pthread.h>
+#include "SimpleCPU/mpsc_queue.h"
 
 class thread_safe_event_if:
   public sc_core::sc_interface
@@ -54,19 +57,61 @@ class thread_safe_event_if:
   virtual void update(void) = 0;
 };
 
+/*
+ * Event which can be notified from any host thread. Every notification is
+ * queued in a lock-free queue and update() schedules all of them: none is lost
+ * when several threads notify before SystemC runs, and the event fires once
+ * per notification. When the queue is full the notification goes to a locked
+ * overflow list instead, which update() drains after the queue.
+ */
 class thread_safe_event:
   sc_core::sc_prim_channel,
   public thread_safe_event_if
 {
   public:
+  /*
+   * Called from update(), on the SystemC thread, for each drained notification
+   * which carries a payload. delay is relative to the current time.
+   */
+  typedef void (*drain_callback)(void *opaque, sc_core::sc_time delay,
+                                 void *payload);
+
   thread_safe_event(const char* name = "");
+  ~thread_safe_event();
   void notify(sc_core::sc_time delay = SC_ZERO_TIME);
+  /* payload is handed to the drain callback by update(). */
+  void notify(sc_core::sc_time delay, void *payload);
   const sc_core::sc_event& default_event(void) const;
+  /* Before the simulation starts. */
+  void set_drain_callback(drain_callback callback, void *opaque);
+  /* Notifications which went through the overflow list. */
+  uint64_t get_overflows() const;
   protected:
   virtual void update(void);
   private:
-  sc_core::sc_event m_event;
-  sc_core::sc_time m_delay;
+  struct notification
+  {
+    uint64_t delay;                     /*<! sc_time value. */
+    void *payload;
+  };
+  static const uint32_t queue_size = 256;
+
+  void drain(const notification &n);
+
+  mpsc_queue<notification, queue_size> m_queue;
+  bool m_update_requested;
+  /*
+   * Once a notification overflowed the following ones go to the list as well
+   * until update() drained it, so that each thread's notifications stay in
+   * order.
+   */
+  pthread_mutex_t m_overflow_mutex;
+  std::deque<notification> m_overflow;  /*<! Under m_overflow_mutex. */
+  bool m_overflowing;
+  uint64_t m_overflows;
+  sc_core::sc_event_queue m_events;
+  drain_callback m_callback;
+  void *m_callback_opaque;
 };
 
 #endif /*!THREAD_SAFE_EVENT_H*/
@@ -44,12 +44,18 @@
 #define TLM2C_SC_BRIDGE_H
 
 #include <systemc>
+#include <queue>
+#include <vector>
+#include <pthread.h>
 #include "greencontrol/config.h"
+#include "SimpleCPU/thread_safe_event.h"
+#include "SimpleCPU/param_snapshot.h"
 
 extern "C"
 {
 #include <tlm2c/tlm2c.h>
 }
+#include "SimpleCPU/tlm2cExtensions.h"
 
 class TLM2CSCBridge:
   public sc_core::sc_module
@@ -58,12 +64,40 @@ class TLM2CSCBridge:
   SC_HAS_PROCESS(TLM2CSCBridge);
   TLM2CSCBridge(sc_core::sc_module_name name);
   ~TLM2CSCBridge();
+  /* Any thread: notify the model in time_ns of SystemC time. */
   void addNotification(uint64_t time_ns);
+  /* Same, but the cookie goes to the registered notify handler instead. */
+  void addNotification(uint64_t time_ns, void *cookie);
+  void register_notify_handler(void *opaque, tlm2c_notify_fired_fn fired);
+  /* Parameters as seen by the model. */
+  param_snapshot *get_parameters();
   virtual void end_of_quantum() = 0;
   virtual void stop_request() = 0;
+  /* Time seen by the model: SystemC time shifted by a restored checkpoint. */
+  uint64_t current_time_ns() const;
+  /* Time reported to the model, ahead of current_time_ns() when decoupled. */
+  virtual uint64_t local_time_ns();
+  /* The model consumed time_ns of its local time. */
+  virtual void advance_local_time(uint64_t time_ns);
+  void register_checkpoint(void *opaque, tlm2c_checkpoint_save_fn save,
+                           tlm2c_checkpoint_restore_fn restore);
 
   protected:
   Socket *(*tlm2c_socket_get_by_name)(const char *name);
+  BridgeExtensions extensions;  /*<! Filled in by additional_init(). */
+  /* SystemC time until the next notification asked by the model, or ~0. */
+  uint64_t next_notification_ns() const;
+  /*
+   * ns until each pending notification. false if one of them carries a cookie:
+   * it is a pointer of the model which can't be saved.
+   */
+  bool pending_notifications(std::vector<uint64_t>& delays);
+  uint64_t time_offset_ns;      /*<! Added to the SystemC time. */
+  /* The model part of a checkpoint, false if the model refused. */
+  bool model_checkpoint_save(std::vector<uint8_t>& blob);
+  bool model_checkpoint_restore(const uint8_t *blob, size_t size);
+  /* The traffic comes from a recording: no library is loaded. */
+  virtual bool replaying() const;
 
   private:
   /*
@@ -74,10 +108,43 @@ class TLM2CSCBridge:
   void end_of_elaboration();
   void notification();
   sc_core::sc_event tlm2c_method;
+  uint64_t notification_at_ns;  /*<! Earliest pending notification or ~0. */
+
+  /*
+   * Notification timers: every request is kept in a min-heap by SystemC time
+   * and all the timers due in the same time step are fired together.
+   */
+  struct notify_timer
+  {
+    uint64_t at_ns;             /*<! Absolute SystemC time. */
+    void *cookie;
+    bool has_cookie;
+  };
+  struct notify_timer_later
+  {
+    bool operator()(const notify_timer& a, const notify_timer& b) const
+    {
+      return a.at_ns > b.at_ns;
+    }
+  };
+  void add_timer(uint64_t time_ns, void *cookie, bool has_cookie);
+  void schedule_timers();
+  std::priority_queue<notify_timer, std::vector<notify_timer>,
+                      notify_timer_later> timers; /*<! SystemC thread only. */
+  pthread_mutex_t timer_mtx;
+  std::vector<notify_timer> timer_requests; /*<! Protected by timer_mtx. */
+  thread_safe_event timer_request_evt;
+  std::vector<void *> fired_cookies;
+  void *notify_opaque;
+  tlm2c_notify_fired_fn notify_fired;
+  void *checkpoint_opaque;
+  tlm2c_checkpoint_save_fn checkpoint_save;
+  tlm2c_checkpoint_restore_fn checkpoint_restore;
   Model *(*tlm2c_elaboration)(Environment *); /*<! Elaboration of tlm2c. */
 
   void init();
   Environment environment;
+  param_snapshot parameters;
   virtual void additional_init() = 0;
 
   /*
@@ -85,13 +152,26 @@ class TLM2CSCBridge:
    */
   void loadLibrary();
   void cleanLibrary();
+  void *openLibraryInstance(const std::string& lib, int occurence);
+  void *openLibraryMemfd(const std::string& lib);
+  void *openLibraryCopy(const std::string& lib, int occurence);
   static std::vector<std::string> libraryNames;
   static std::vector<int> libraryOccurence;
   std::string libraryAssociated; /*<! Filename for the associated library. */
   bool removeLibrary;            /*<! Remove the library in the destructor. */
   void *libraryHandle;           /*<! Handle for the opened library. */
+  int libraryFd;                 /*<! memfd holding the copy or -1. */
 
   gs::gs_param<std::string> libraryName; /*<! Library name for this CPU */
+  /*
+   * How the extra instances of a library get their own globals:
+   * "auto": memfd, falling back to copy.
+   * "memfd": load a copy held in an anonymous file (Linux).
+   * "copy": load a copy written next to the library.
+   * "dlmopen": load it in a new link-map namespace. The library gets its own
+   *            libc too: it must not free memory allocated by the bridge.
+   */
+  gs::gs_param<std::string> libraryLoader;
 
 };
 
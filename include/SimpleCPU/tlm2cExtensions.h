@@ -0,0 +1,157 @@
+/*
+ * tlm2cExtensions.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#ifndef TLM2C_EXTENSIONS_H
+#define TLM2C_EXTENSIONS_H
+
+/*
+ * Extra services offered by the bridge to a tlm2c model, on top of the
+ * Environment. This header is plain C so model libraries can include it.
+ *
+ * If the model library exports TLM2C_BRIDGE_EXTENSIONS_SYMBOL the bridge calls
+ * it right after tlm2c_elaboration with a table the model may keep. Entries the
+ * bridge doesn't provide are NULL, and size tells which entries exist at all.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <tlm2c/tlm2c.h>
+
+/*
+ * Checkpoint hooks of the model. save() is first called with a NULL buffer and
+ * returns the size it needs, then with a buffer of that size and returns what
+ * it wrote. restore() returns 0 on success.
+ */
+typedef size_t (*tlm2c_checkpoint_save_fn)(void *opaque, void *buffer,
+                                           size_t size);
+typedef int (*tlm2c_checkpoint_restore_fn)(void *opaque, const void *buffer,
+                                           size_t size);
+
+/*
+ * Called from the SystemC thread with the cookies of all the timers due in the
+ * current time step, in the order they expire.
+ */
+typedef void (*tlm2c_notify_fired_fn)(void *opaque, void *const *cookies,
+                                      size_t count);
+
+typedef struct BridgeExtensions
+{
+  size_t size;                  /*<! sizeof(BridgeExtensions) in the bridge. */
+  void *handler;                /*<! First argument of every entry. */
+
+  /*
+   * Access len bytes at address in one go: one copy for DMI, one transaction
+   * otherwise. Returns a ResponseStatus.
+   */
+  int (*memory_burst)(void *handler, Command cmd, uint64_t address,
+                      uint8_t *data, size_t len);
+
+  /*
+   * Include the model state in the checkpoints. Both hooks are called from
+   * the SystemC thread while the model is stopped at a quantum boundary.
+   */
+  void (*register_checkpoint)(void *handler, void *opaque,
+                              tlm2c_checkpoint_save_fn save,
+                              tlm2c_checkpoint_restore_fn restore);
+
+  /*
+   * Like Environment.request_notify, but the timer fires the handler given to
+   * register_notify_handler with cookie instead of calling model_notify().
+   * Without a handler it behaves like request_notify. Any number of timers can
+   * be pending: none replaces another.
+   */
+  void (*request_notify_cookie)(void *handler, uint64_t time_ns,
+                                void *cookie);
+  void (*register_notify_handler)(void *handler, void *opaque,
+                                  tlm2c_notify_fired_fn fired);
+
+  /*
+   * Parameters without a copy: the strings belong to the bridge and stay
+   * valid until it is destroyed, they must not be freed. get_param_string
+   * returns NULL for an unknown parameter. get_params borrows the names and
+   * values of the parameters starting with prefix, at most max of them, and
+   * returns how many match.
+   */
+  const char *(*get_param_string)(void *handler, const char *name);
+  size_t (*get_params)(void *handler, const char *prefix, const char **names,
+                       const char **values, size_t max);
+
+  /*
+   * Temporal decoupling: the model spent time_ns of local time, eg. executing
+   * instructions. The call may end the quantum and block until SystemC caught
+   * up. Accesses add their own time but never end the quantum: the model must
+   * call this regularly, with 0 when it has nothing to add. Ignored when the
+   * bridge doesn't decouple.
+   */
+  void (*advance_time)(void *handler, uint64_t time_ns);
+
+  /*
+   * Non-blocking accesses. memory_issue queues an access of len bytes and
+   * returns without waiting for it: data must stay valid until its completion
+   * is collected. Accesses are done in the order they were issued, together
+   * with the blocking ones. It only blocks when too many are in flight.
+   *
+   * memory_collect returns 1 and the tag and ResponseStatus of the oldest
+   * completed access, 0 if none completed yet and wait is 0, -1 if nothing is
+   * in flight. With wait set it blocks until an access completes.
+   */
+  void (*memory_issue)(void *handler, Command cmd, uint64_t address,
+                       uint8_t *data, size_t len, uint64_t tag);
+  int (*memory_collect)(void *handler, uint64_t *tag, int *status, int wait);
+} BridgeExtensions;
+
+#define TLM2C_BRIDGE_EXTENSIONS_SYMBOL "tlm2c_bridge_extensions"
+typedef void (*tlm2c_bridge_extensions_fn)(Model *model,
+                                           const BridgeExtensions *extensions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TLM2C_EXTENSIONS_H */
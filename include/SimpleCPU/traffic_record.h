@@ -0,0 +1,146 @@
+/*
+ * traffic_record.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+#ifndef TRAFFIC_RECORD_H
+#define TRAFFIC_RECORD_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+ * Recorded CPU traffic: one traffic_record_header followed by traffic_record
+ * entries in the order they were recorded, all in host byte order. A write
+ * wider than 8 bytes is followed by its data, padded to 8 bytes.
+ */
+#define TRAFFIC_RECORD_MAGIC "SCPUREC"
+#define TRAFFIC_RECORD_VERSION 1
+
+enum traffic_record_kind
+{
+  TRAFFIC_READ = 0,
+  TRAFFIC_WRITE,
+  TRAFFIC_IRQ,                        /* address: line, value: level. */
+  TRAFFIC_QUANTUM                     /* value: new quantum length in ns. */
+};
+
+/* How the access was served when it was recorded. */
+enum traffic_record_route
+{
+  TRAFFIC_ROUTE_TRANSACTION = 0,      /* Went through master_socket. */
+  TRAFFIC_ROUTE_DMI,
+  TRAFFIC_ROUTE_FPGA,
+  TRAFFIC_ROUTE_SHADOW
+};
+
+#define TRAFFIC_FLAG_POSTED 0x01
+/* Recorded before its response: the status field means nothing. */
+#define TRAFFIC_FLAG_STATUS_UNKNOWN 0x02
+/* Write-back of shadow writes which were recorded when they were made. */
+#define TRAFFIC_FLAG_SHADOW_FLUSH 0x04
+
+typedef struct traffic_record_header
+{
+  char magic[8];                      /*<! TRAFFIC_RECORD_MAGIC. */
+  uint32_t version;
+  uint32_t record_size;               /*<! sizeof(traffic_record). */
+  uint64_t quantum_ns;                /*<! Length of the first quantum. */
+} traffic_record_header;
+
+typedef struct traffic_record
+{
+  uint64_t sc_ps;                     /*<! SystemC time, local if decoupled. */
+  uint64_t address;
+  uint64_t value;                     /*<! Data of accesses up to 8 bytes. */
+  uint32_t size;
+  uint8_t kind;                       /*<! traffic_record_kind. */
+  uint8_t route;                      /*<! traffic_record_route. */
+  uint8_t status;                     /*<! ResponseStatus of the access. */
+  uint8_t flags;
+} traffic_record;
+
+/*
+ * Records are written under a mutex, the CPU thread and SystemC both record.
+ * Nothing is dropped on purpose: a replay needs every access, so the writes
+ * which failed are counted and close() tells whether the recording is whole.
+ */
+class traffic_recorder
+{
+  public:
+  traffic_recorder();
+  ~traffic_recorder();
+  bool open(const std::string& path, uint64_t quantum_ns);
+  /* false if a write failed, the final flush included. */
+  bool close();
+  /* Any thread. data holds the size bytes of a write wider than 8 bytes. */
+  void record(const traffic_record& record, const uint8_t *data);
+  uint64_t get_count();
+  uint64_t get_write_errors();
+
+  private:
+  FILE *file;
+  pthread_mutex_t mtx;
+  uint64_t count;
+  uint64_t write_errors;
+};
+
+class traffic_reader
+{
+  public:
+  traffic_reader();
+  ~traffic_reader();
+  bool open(const std::string& path);
+  const traffic_record_header& header() const;
+  /* false at the end of the stream. *data stays valid until the next call. */
+  bool next(traffic_record *record, const uint8_t **data);
+
+  private:
+  FILE *file;
+  traffic_record_header head;
+  std::vector<uint8_t> burst;
+};
+
+#endif /* !TRAFFIC_RECORD_H */
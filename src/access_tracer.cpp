@@ -0,0 +1,157 @@
+/*
+ * access_tracer.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/access_tracer.h"
+#include "SimpleCPU/host_time.h"
+
+#include <string.h>
+
+access_tracer::access_tracer():
+  filter_start(0),
+  filter_end(~(uint64_t)0),
+  sample_period(1),
+  sample_count(0),
+  dropped(0),
+  file(NULL),
+  running(false),
+  wake_pending(false)
+{
+
+}
+
+access_tracer::~access_tracer()
+{
+  this->close();
+}
+
+bool access_tracer::open(const std::string& path)
+{
+  access_trace_header header;
+
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ACCESS_TRACE_MAGIC, sizeof(ACCESS_TRACE_MAGIC));
+  header.version = ACCESS_TRACE_VERSION;
+  header.record_size = sizeof(access_trace_record);
+  header.host_start_ns = host_time_ns();
+  fwrite(&header, sizeof(header), 1, file);
+
+  running = true;
+  if (pthread_create(&writer, NULL, writer_thread, this) != 0)
+  {
+    running = false;
+    fclose(file);
+    file = NULL;
+    return false;
+  }
+  return true;
+}
+
+void access_tracer::close()
+{
+  if (!file)
+  {
+    return;
+  }
+
+  __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+  writer_wakeup.post();
+  pthread_join(writer, NULL);
+  /* The CPU is done: whatever is left can be written from here. */
+  this->drain();
+  fclose(file);
+  file = NULL;
+}
+
+void access_tracer::set_filter(uint64_t start, uint64_t end)
+{
+  filter_start = start;
+  filter_end = end;
+}
+
+void access_tracer::set_sampling(uint32_t one_in_n)
+{
+  sample_period = one_in_n ? one_in_n : 1;
+  sample_count = 0;
+}
+
+uint64_t access_tracer::get_dropped() const
+{
+  return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+void access_tracer::drain()
+{
+  access_trace_record *record;
+
+  while ((record = ring.peek()) != NULL)
+  {
+    fwrite(record, sizeof(*record), 1, file);
+    ring.release();
+  }
+}
+
+void *access_tracer::writer_thread(void *opaque)
+{
+  access_tracer *_this = (access_tracer *)opaque;
+
+  while (true)
+  {
+    /* Sleeps until the ring is half full or the trace is closed. */
+    _this->writer_wakeup.wait();
+    if (!__atomic_load_n(&_this->running, __ATOMIC_ACQUIRE))
+    {
+      /* close() drains what is left. */
+      break;
+    }
+    /* Cleared first: a batch filling up during the drain posts again. */
+    __atomic_store_n(&_this->wake_pending, false, __ATOMIC_SEQ_CST);
+    _this->drain();
+  }
+  return NULL;
+}
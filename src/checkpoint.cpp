@@ -0,0 +1,279 @@
+/*
+ * checkpoint.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t checkpoint_page_size()
+{
+#ifndef _WIN32
+  return sysconf(_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+checkpoint_writer::checkpoint_writer()
+{
+
+}
+
+void checkpoint_writer::add_region(uint64_t start, uint64_t end,
+                                   const uint8_t *data)
+{
+  checkpoint_region region;
+
+  region.start = start;
+  region.end = end;
+  region.offset = 0;
+  this->regions.push_back(region);
+  this->data.push_back(data);
+}
+
+bool checkpoint_writer::write(const std::string& path,
+                              const checkpoint_header& state,
+                              const std::vector<uint8_t>& model,
+                              const std::vector<uint64_t>& notifications)
+{
+  checkpoint_header header = state;
+  uint64_t offset;
+  FILE *file;
+  bool ok;
+
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header.version = CHECKPOINT_VERSION;
+  header.region_count = regions.size();
+  header.page_size = checkpoint_page_size();
+  header.notification_count = notifications.size();
+  header.model_offset = sizeof(header)
+                      + regions.size() * sizeof(checkpoint_region)
+                      + notifications.size() * sizeof(uint64_t);
+  header.model_size = model.size();
+
+  offset = header.model_offset + header.model_size;
+  for (size_t i = 0; i < regions.size(); i++)
+  {
+    regions[i].offset = align_up(offset, header.page_size);
+    offset = regions[i].offset + (regions[i].end - regions[i].start + 1);
+  }
+
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+
+  ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !regions.empty())
+  {
+    ok = fwrite(&regions[0], sizeof(checkpoint_region), regions.size(), file)
+         == regions.size();
+  }
+  if (ok && !notifications.empty())
+  {
+    ok = fwrite(&notifications[0], sizeof(uint64_t), notifications.size(),
+                file) == notifications.size();
+  }
+  if (ok && !model.empty())
+  {
+    ok = fwrite(&model[0], 1, model.size(), file) == model.size();
+  }
+  for (size_t i = 0; ok && i < regions.size(); i++)
+  {
+    uint64_t size = regions[i].end - regions[i].start + 1;
+
+    ok = !fseek(file, regions[i].offset, SEEK_SET)
+      && fwrite(data[i], 1, size, file) == size;
+  }
+
+  return !fclose(file) && ok;
+}
+
+checkpoint_image::checkpoint_image():
+  image(NULL),
+  size(0),
+  fd(-1)
+{
+
+}
+
+checkpoint_image::~checkpoint_image()
+{
+#ifndef _WIN32
+  /* Regions mapped copy on write keep their own reference on the file. */
+  if (image)
+  {
+    munmap(image, size);
+  }
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+#else
+  free(image);
+#endif
+}
+
+bool checkpoint_image::open(const std::string& path)
+{
+  const checkpoint_header *h;
+  const checkpoint_region *r;
+
+#ifndef _WIN32
+  struct stat st;
+
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0 || fstat(fd, &st))
+  {
+    return false;
+  }
+  size = st.st_size;
+  if (size < sizeof(checkpoint_header))
+  {
+    return false;
+  }
+  image = (uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (image == MAP_FAILED)
+  {
+    image = NULL;
+    return false;
+  }
+#else
+  FILE *file = fopen(path.c_str(), "rb");
+
+  if (!file)
+  {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  image = (uint8_t *)malloc(size);
+  if (size < sizeof(checkpoint_header)
+   || fread(image, 1, size, file) != size)
+  {
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+#endif
+
+  /* Check everything the accessors rely on. */
+  h = (const checkpoint_header *)image;
+  if (memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))
+   || h->version != CHECKPOINT_VERSION
+   || h->model_offset > size || h->model_size > size - h->model_offset
+   || h->notification_count > size / sizeof(uint64_t)
+   || sizeof(*h) + (uint64_t)h->region_count * sizeof(*r)
+      + h->notification_count * sizeof(uint64_t) > h->model_offset)
+  {
+    return false;
+  }
+  r = (const checkpoint_region *)(h + 1);
+  for (uint32_t i = 0; i < h->region_count; i++)
+  {
+    if (r[i].end < r[i].start || r[i].offset > size
+     || r[i].end - r[i].start >= size - r[i].offset)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+const checkpoint_header& checkpoint_image::header() const
+{
+  return *(const checkpoint_header *)image;
+}
+
+const checkpoint_region& checkpoint_image::region(uint32_t index) const
+{
+  return ((const checkpoint_region *)(image + sizeof(checkpoint_header)))
+         [index];
+}
+
+const uint8_t *checkpoint_image::model() const
+{
+  return image + header().model_offset;
+}
+
+const uint64_t *checkpoint_image::notifications() const
+{
+  return (const uint64_t *)(image + sizeof(checkpoint_header)
+                            + header().region_count
+                              * sizeof(checkpoint_region));
+}
+
+bool checkpoint_image::restore_region(uint32_t index, uint8_t *host,
+                                      bool cow) const
+{
+  const checkpoint_region& r = region(index);
+  uint64_t length = r.end - r.start + 1;
+
+#ifndef _WIN32
+  uint64_t page = checkpoint_page_size();
+
+  if (cow && !((uintptr_t)host & (page - 1)) && !(length & (page - 1))
+      && !(r.offset & (page - 1)))
+  {
+    return mmap(host, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, r.offset) != MAP_FAILED;
+  }
+#endif
+  memcpy(host, image + r.offset, length);
+  return true;
+}
@@ -0,0 +1,159 @@
+/*
+ * dmi_table.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/dmi_table.h"
+
+#include <algorithm>
+
+static bool region_starts_before(uint64_t address, const dmi_region& region)
+{
+  return address < region.start;
+}
+
+dmi_table::dmi_table():
+  last_hit(0)
+{
+
+}
+
+const dmi_region *dmi_table::lookup(uint64_t address)
+{
+  std::vector<dmi_region>::iterator it;
+
+  /* Most accesses hit the same region as the previous one. */
+  if (last_hit < regions.size()
+      && address >= regions[last_hit].start
+      && address <= regions[last_hit].end)
+  {
+    return &regions[last_hit];
+  }
+
+  /* Find the last region starting at or before address. */
+  it = std::upper_bound(regions.begin(), regions.end(), address,
+                        region_starts_before);
+  if (it == regions.begin())
+  {
+    return NULL;
+  }
+  it--;
+  if (address > it->end)
+  {
+    return NULL;
+  }
+
+  last_hit = it - regions.begin();
+  return &(*it);
+}
+
+void dmi_table::insert(const dmi_region& region)
+{
+  std::vector<dmi_region>::iterator it;
+
+  /* The new grant replaces whatever it overlaps. */
+  this->invalidate(region.start, region.end);
+  it = std::upper_bound(regions.begin(), regions.end(), region.start,
+                        region_starts_before);
+  regions.insert(it, region);
+}
+
+void dmi_table::invalidate(uint64_t start, uint64_t end)
+{
+  std::vector<dmi_region>::iterator it = regions.begin();
+
+  while (it != regions.end())
+  {
+    if (it->start <= end && it->end >= start)
+    {
+      it = regions.erase(it);
+    }
+    else
+    {
+      it++;
+    }
+  }
+  last_hit = 0;
+}
+
+size_t dmi_table::count() const
+{
+  return regions.size();
+}
+
+const dmi_region& dmi_table::at(size_t index) const
+{
+  return regions[index];
+}
+
+void dmi_table::clear()
+{
+  regions.clear();
+  last_hit = 0;
+}
+
+void dmi_range_merge(std::vector<dmi_range>& ranges, uint64_t start,
+                     uint64_t end)
+{
+  std::vector<dmi_range>::iterator it = ranges.begin();
+  dmi_range merged;
+
+  merged.start = start;
+  merged.end = end;
+
+  /* Skip the ranges entirely before, without touching. */
+  while (it != ranges.end() && it->end != ~(uint64_t)0
+         && it->end + 1 < merged.start)
+  {
+    it++;
+  }
+
+  /* Absorb everything overlapping or adjacent. */
+  while (it != ranges.end()
+         && (merged.end == ~(uint64_t)0 || it->start <= merged.end + 1))
+  {
+    merged.start = std::min(merged.start, it->start);
+    merged.end = std::max(merged.end, it->end);
+    it = ranges.erase(it);
+  }
+
+  ranges.insert(it, merged);
+}
@@ -0,0 +1,101 @@
+/*
+ * irq_coalescer.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/irq_coalescer.h"
+
+#include <string.h>
+
+irq_coalescer::irq_coalescer():
+  pending(false),
+  edges(0),
+  deliveries(0)
+{
+  memset(levels, 0, sizeof(levels));
+  memset(changed, 0, sizeof(changed));
+  memset(immediate, 0, sizeof(immediate));
+}
+
+void irq_coalescer::set_immediate(uint32_t line)
+{
+  if (line < line_count)
+  {
+    immediate[line / 64] |= (uint64_t)1 << (line % 64);
+  }
+}
+
+uint32_t irq_coalescer::drain(deliver_fn deliver, void *opaque)
+{
+  uint32_t count = 0;
+
+  /*
+   * Clear the flag first: a line changing while we scan sets it again and is
+   * picked up either now or by the next drain.
+   */
+  __atomic_store_n(&pending, false, __ATOMIC_SEQ_CST);
+  for (uint32_t w = 0; w < words; w++)
+  {
+    uint64_t bits = __atomic_exchange_n(&changed[w], 0, __ATOMIC_ACQ_REL);
+    uint64_t level = __atomic_load_n(&levels[w], __ATOMIC_ACQUIRE);
+
+    while (bits)
+    {
+      uint32_t bit = __builtin_ctzll(bits);
+
+      bits &= bits - 1;
+      deliver(opaque, w * 64 + bit, (level >> bit) & 1);
+      count++;
+    }
+  }
+  __atomic_add_fetch(&deliveries, count, __ATOMIC_RELAXED);
+  return count;
+}
+
+uint64_t irq_coalescer::get_edges() const
+{
+  return __atomic_load_n(&edges, __ATOMIC_RELAXED);
+}
+
+uint64_t irq_coalescer::get_deliveries() const
+{
+  return __atomic_load_n(&deliveries, __ATOMIC_RELAXED);
+}
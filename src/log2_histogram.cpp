@@ -0,0 +1,115 @@
+/*
+ * log2_histogram.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/log2_histogram.h"
+
+#include <algorithm>
+#include <string.h>
+
+log2_histogram::log2_histogram()
+{
+  this->clear();
+}
+
+void log2_histogram::clear()
+{
+  memset(buckets, 0, sizeof(buckets));
+  samples = 0;
+  total = 0;
+  maximum = 0;
+}
+
+void log2_histogram::merge(const log2_histogram& other)
+{
+  for (unsigned int i = 0; i < bucket_count; i++)
+  {
+    buckets[i] += other.buckets[i];
+  }
+  samples += other.samples;
+  total += other.total;
+  if (other.maximum > maximum)
+  {
+    maximum = other.maximum;
+  }
+}
+
+static uint64_t bucket_high(unsigned int n)
+{
+  /* Bucket 64 has no representable upper bound. */
+  return (n < 64) ? (uint64_t)1 << n : ~(uint64_t)0;
+}
+
+uint64_t log2_histogram::percentile(unsigned int percent) const
+{
+  uint64_t rank = (samples * percent + 99) / 100;
+  uint64_t seen = 0;
+
+  if (!samples)
+  {
+    return 0;
+  }
+
+  for (unsigned int i = 0; i < bucket_count; i++)
+  {
+    seen += buckets[i];
+    if (seen >= rank && seen)
+    {
+      /* Never report more than what was actually seen. */
+      return std::min(bucket_high(i), maximum);
+    }
+  }
+  return maximum;
+}
+
+void log2_histogram::print(std::ostream& os, const char *prefix) const
+{
+  for (unsigned int i = 0; i < bucket_count; i++)
+  {
+    if (!buckets[i])
+    {
+      continue;
+    }
+    os << prefix << "[" << (i ? (uint64_t)1 << (i - 1) : 0) << ", "
+       << bucket_high(i) << ") " << buckets[i] << std::endl;
+  }
+}
@@ -0,0 +1,249 @@
+/*
+ * mmio_profiler.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/mmio_profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string.h>
+
+static const char *route_names[MMIO_ROUTE_COUNT] = {
+  "dmi",
+  "fpga",
+  "transaction"
+};
+
+mmio_profiler::mmio_profiler(unsigned int page_shift):
+  page_shift(page_shift),
+  table_bits(8),
+  used(0),
+  last(NULL)
+{
+  table = new entry *[1 << table_bits];
+  memset(table, 0, sizeof(entry *) << table_bits);
+  pthread_mutex_init(&mtx, NULL);
+}
+
+mmio_profiler::~mmio_profiler()
+{
+  for (uint32_t i = 0; i < (1U << table_bits); i++)
+  {
+    delete table[i];
+  }
+  delete [] table;
+  pthread_mutex_destroy(&mtx);
+}
+
+static bool range_before(const dmi_range& a, const dmi_range& b)
+{
+  return a.start < b.start;
+}
+
+bool mmio_profiler::add_region(uint64_t start, uint64_t end)
+{
+  std::vector<dmi_range>::iterator it;
+  dmi_range range;
+
+  range.start = start;
+  range.end = end;
+  it = std::upper_bound(regions.begin(), regions.end(), range, range_before);
+  /* An access must be counted in exactly one region. */
+  if ((it != regions.end() && it->start <= end)
+      || (it != regions.begin() && (it - 1)->end >= start))
+  {
+    return false;
+  }
+  regions.insert(it, range);
+  return true;
+}
+
+uint32_t mmio_profiler::slot_of(uint64_t start) const
+{
+  return (uint32_t)((start * 0x9E3779B97F4A7C15ULL) >> (64 - table_bits));
+}
+
+mmio_profiler::entry *mmio_profiler::lookup(uint64_t address)
+{
+  uint64_t start = (address >> page_shift) << page_shift;
+  uint64_t end = start + ((uint64_t)1 << page_shift) - 1;
+  std::vector<dmi_range>::iterator it;
+  dmi_range key;
+  uint32_t slot;
+  entry *e;
+
+  /* The configured regions take precedence over the pages. */
+  key.start = address;
+  key.end = address;
+  it = std::upper_bound(regions.begin(), regions.end(), key, range_before);
+  if (it != regions.begin() && address <= (it - 1)->end)
+  {
+    start = (it - 1)->start;
+    end = (it - 1)->end;
+  }
+  else
+  {
+    /* A page partially covered by a region stops at its boundaries. */
+    if (it != regions.begin() && (it - 1)->end >= start)
+    {
+      start = (it - 1)->end + 1;
+    }
+    if (it != regions.end() && it->start <= end)
+    {
+      end = it->start - 1;
+    }
+  }
+
+  for (slot = slot_of(start); (e = table[slot]) != NULL;
+       slot = (slot + 1) & ((1U << table_bits) - 1))
+  {
+    if (e->start == start)
+    {
+      return e;
+    }
+  }
+
+  e = new entry();
+  e->start = start;
+  e->end = end;
+
+  pthread_mutex_lock(&mtx);
+  table[slot] = e;
+  used++;
+  if (used * 4 > (3U << table_bits))
+  {
+    this->grow();
+  }
+  pthread_mutex_unlock(&mtx);
+  return e;
+}
+
+void mmio_profiler::grow()
+{
+  entry **old = table;
+  uint32_t old_size = 1U << table_bits;
+  uint32_t slot;
+
+  table_bits++;
+  table = new entry *[1 << table_bits];
+  memset(table, 0, sizeof(entry *) << table_bits);
+  for (uint32_t i = 0; i < old_size; i++)
+  {
+    if (!old[i])
+    {
+      continue;
+    }
+    for (slot = slot_of(old[i]->start); table[slot];
+         slot = (slot + 1) & ((1U << table_bits) - 1));
+    table[slot] = old[i];
+  }
+  delete [] old;
+}
+
+struct mmio_report_line
+{
+  uint64_t start;
+  uint64_t end;
+  mmio_route route;
+  const mmio_route_stats *stats;
+};
+
+static bool busiest_first(const mmio_report_line& a,
+                          const mmio_report_line& b)
+{
+  return a.stats->host_ns.sum() > b.stats->host_ns.sum();
+}
+
+void mmio_profiler::report(std::ostream& os, bool histograms) const
+{
+  std::vector<mmio_report_line> lines;
+  mmio_report_line line;
+
+  pthread_mutex_lock(&mtx);
+  for (uint32_t i = 0; i < (1U << table_bits); i++)
+  {
+    if (!table[i])
+    {
+      continue;
+    }
+    for (unsigned int r = 0; r < MMIO_ROUTE_COUNT; r++)
+    {
+      if (!table[i]->routes[r].host_ns.count())
+      {
+        continue;
+      }
+      line.start = table[i]->start;
+      line.end = table[i]->end;
+      line.route = (mmio_route)r;
+      line.stats = &table[i]->routes[r];
+      lines.push_back(line);
+    }
+  }
+  /* Sorted by total host time: what costs the most comes first. */
+  std::sort(lines.begin(), lines.end(), busiest_first);
+
+  os << "MMIO profile: " << lines.size() << " region/route pairs" << std::endl;
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    const mmio_route_stats *s = lines[i].stats;
+
+    os << std::hex << "0x" << std::setw(16) << std::setfill('0')
+       << lines[i].start << "-0x" << std::setw(16) << lines[i].end
+       << std::dec << std::setfill(' ') << " " << route_names[lines[i].route]
+       << ": reads=" << s->reads << " writes=" << s->writes
+       << " bytes=" << s->bytes
+       << " host_ns(total/mean/p50/p99/max)=" << s->host_ns.sum() << "/"
+       << s->host_ns.mean() << "/" << s->host_ns.percentile(50) << "/"
+       << s->host_ns.percentile(99) << "/" << s->host_ns.max()
+       << " sc_ps(total/mean/p50/p99/max)=" << s->sc_ps.sum() << "/"
+       << s->sc_ps.mean() << "/" << s->sc_ps.percentile(50) << "/"
+       << s->sc_ps.percentile(99) << "/" << s->sc_ps.max() << std::endl;
+    if (histograms)
+    {
+      os << "  host ns:" << std::endl;
+      s->host_ns.print(os, "    ");
+      os << "  SystemC ps:" << std::endl;
+      s->sc_ps.print(os, "    ");
+    }
+  }
+  pthread_mutex_unlock(&mtx);
+}
@@ -0,0 +1,312 @@
+/*
+ * param_snapshot.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/param_snapshot.h"
+
+#include <cstring>
+
+static uint32_t name_hash(const char *name)
+{
+  /* FNV-1a. */
+  uint32_t hash = 2166136261U;
+
+  while (*name)
+  {
+    hash = (hash ^ (uint8_t)*name++) * 16777619U;
+  }
+  return hash;
+}
+
+param_snapshot::param_snapshot():
+  table_bits(8),
+  enabled(false)
+{
+  table = new entry *[1 << table_bits];
+  memset(table, 0, sizeof(entry *) << table_bits);
+  pthread_mutex_init(&mtx, NULL);
+}
+
+param_snapshot::~param_snapshot()
+{
+  GC_UNREGISTER_CALLBACKS();
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    delete entries[i];
+  }
+  delete [] table;
+  pthread_mutex_destroy(&mtx);
+}
+
+void param_snapshot::enable()
+{
+  pthread_mutex_lock(&mtx);
+  enabled = true;
+  pthread_mutex_unlock(&mtx);
+}
+
+const char *param_snapshot::get_string(const char *name)
+{
+  const char *value = NULL;
+  entry *e;
+
+  pthread_mutex_lock(&mtx);
+  e = this->lookup(name);
+  if (e)
+  {
+    value = this->value_of(e);
+  }
+  pthread_mutex_unlock(&mtx);
+  return value;
+}
+
+bool param_snapshot::get_uint(const char *name, uint64_t *value)
+{
+  entry *e;
+
+  pthread_mutex_lock(&mtx);
+  e = this->lookup(name);
+  if (e && !e->has_uint)
+  {
+    e->has_uint = e->par->getValue(e->uint_value);
+  }
+  if (e && e->has_uint)
+  {
+    *value = e->uint_value;
+  }
+  pthread_mutex_unlock(&mtx);
+  return e && e->has_uint;
+}
+
+bool param_snapshot::get_int(const char *name, int64_t *value)
+{
+  entry *e;
+
+  pthread_mutex_lock(&mtx);
+  e = this->lookup(name);
+  if (e && !e->has_int)
+  {
+    e->has_int = e->par->getValue(e->int_value);
+  }
+  if (e && e->has_int)
+  {
+    *value = e->int_value;
+  }
+  pthread_mutex_unlock(&mtx);
+  return e && e->has_int;
+}
+
+size_t param_snapshot::get_all(const char *prefix, const char **names,
+                               const char **values, size_t max)
+{
+  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
+  std::vector<std::string> params;
+  size_t length = strlen(prefix);
+  size_t found = 0;
+  entry *e;
+  assert(Api);
+
+  params = Api->getParamList();
+  pthread_mutex_lock(&mtx);
+  for (size_t i = 0; i < params.size(); i++)
+  {
+    if (params[i].compare(0, length, prefix) != 0)
+    {
+      continue;
+    }
+    e = this->lookup(params[i].c_str());
+    if (!e)
+    {
+      continue;
+    }
+    if (found < max)
+    {
+      names[found] = e->name.c_str();
+      values[found] = this->value_of(e);
+    }
+    found++;
+  }
+  pthread_mutex_unlock(&mtx);
+  return found;
+}
+
+std::vector<std::string> param_snapshot::names()
+{
+  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
+  assert(Api);
+
+  /* Rare enough to ask GreenControl every time. */
+  return Api->getParamList();
+}
+
+param_snapshot::entry *param_snapshot::find(const char *name) const
+{
+  uint32_t mask = (1U << table_bits) - 1;
+  uint32_t slot;
+
+  for (slot = name_hash(name) & mask; table[slot];
+       slot = (slot + 1) & mask)
+  {
+    if (table[slot]->name == name)
+    {
+      return table[slot];
+    }
+  }
+  return NULL;
+}
+
+param_snapshot::entry *param_snapshot::lookup(const char *name)
+{
+  entry *e = this->find(name);
+  gs::cnf::cnf_api *Api;
+  gs::gs_param_base *par;
+
+  if ((e && e->par) || !enabled)
+  {
+    return (e && e->par) ? e : NULL;
+  }
+
+  /* First use, or destroyed and created again. */
+  Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
+  par = Api->getPar(name);
+  if (!par)
+  {
+    return NULL;
+  }
+  if (!e)
+  {
+    return this->add(par);
+  }
+  e->par = par;
+  this->watch(par);
+  return e;
+}
+
+param_snapshot::entry *param_snapshot::add(gs::gs_param_base *par)
+{
+  uint32_t mask;
+  uint32_t slot;
+  entry *e = new entry;
+
+  e->name = par->getName();
+  e->par = par;
+  e->value = NULL;
+  e->has_uint = false;
+  e->has_int = false;
+  entries.push_back(e);
+
+  if (entries.size() * 2 > (1U << table_bits))
+  {
+    this->grow();
+  }
+  mask = (1U << table_bits) - 1;
+  for (slot = name_hash(e->name.c_str()) & mask; table[slot];
+       slot = (slot + 1) & mask);
+  table[slot] = e;
+  this->watch(par);
+  return e;
+}
+
+void param_snapshot::watch(gs::gs_param_base *par)
+{
+  GC_REGISTER_TYPED_PARAM_CALLBACK(par, gs::cnf::post_write, param_snapshot,
+                                   param_changed);
+  GC_REGISTER_TYPED_PARAM_CALLBACK(par, gs::cnf::destroy_param,
+                                   param_snapshot, param_changed);
+}
+
+const char *param_snapshot::value_of(entry *e)
+{
+  if (!e->value)
+  {
+    /* The set never moves its strings: the pointer outlives the entry. */
+    e->value = strings.insert(e->par->getString()).first->c_str();
+  }
+  return e->value;
+}
+
+void param_snapshot::grow()
+{
+  entry **old = table;
+  uint32_t old_size = 1U << table_bits;
+  uint32_t mask;
+  uint32_t slot;
+
+  table_bits++;
+  mask = (1U << table_bits) - 1;
+  table = new entry *[1 << table_bits];
+  memset(table, 0, sizeof(entry *) << table_bits);
+  for (uint32_t i = 0; i < old_size; i++)
+  {
+    if (!old[i])
+    {
+      continue;
+    }
+    for (slot = name_hash(old[i]->name.c_str()) & mask; table[slot];
+         slot = (slot + 1) & mask);
+    table[slot] = old[i];
+  }
+  delete [] old;
+}
+
+gs::cnf::callback_return_type param_snapshot::param_changed(
+                                                gs::gs_param_base& par,
+                                                gs::cnf::callback_type reason)
+{
+  entry *e;
+
+  pthread_mutex_lock(&mtx);
+  e = this->find(par.getName().c_str());
+  if (e && e->par == &par)
+  {
+    /* The old string stays interned: the model may still hold it. */
+    e->value = NULL;
+    e->has_uint = false;
+    e->has_int = false;
+    if (reason == gs::cnf::destroy_param)
+    {
+      e->par = NULL;
+    }
+  }
+  pthread_mutex_unlock(&mtx);
+  return gs::cnf::return_nothing;
+}
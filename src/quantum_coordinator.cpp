@@ -0,0 +1,161 @@
+/*
+ * quantum_coordinator.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include <systemc.h>
+#include "SimpleCPU/quantum_coordinator.h"
+
+#include <algorithm>
+
+std::map<std::string, quantum_coordinator *> quantum_coordinator::groups;
+
+quantum_coordinator::quantum_coordinator(const std::string& group,
+                                         uint64_t quantum_ns):
+  group(group),
+  finished(0),
+  waiting(false),
+  interrupted(false),
+  started(false),
+  quantum(quantum_ns)
+{
+  sc_core::sc_spawn_options options;
+
+  options.spawn_method();
+  options.set_sensitivity(&barrier_evt);
+  options.dont_initialize();
+  sc_core::sc_spawn(sc_bind(&quantum_coordinator::barrier, this),
+                    ("simplecpu_quantum_barrier" + (group.empty() ? ""
+                                                    : "_" + group)).c_str(),
+                    &options);
+  barrier_evt.notify(quantum, sc_core::SC_NS);
+}
+
+quantum_coordinator::~quantum_coordinator()
+{
+  barrier_evt.cancel();
+}
+
+quantum_coordinator *quantum_coordinator::join(const std::string& group,
+                                               quantum_member *member,
+                                               uint64_t quantum_ns,
+                                               wait_policy policy,
+                                               uint32_t spin_count)
+{
+  quantum_coordinator *&coordinator = groups[group];
+
+  /* Elaboration is single threaded. The first CPU sets the quantum. */
+  if (!coordinator)
+  {
+    coordinator = new quantum_coordinator(group, quantum_ns);
+    coordinator->doorbell.set_policy(policy, spin_count);
+  }
+  coordinator->members.push_back(member);
+  return coordinator;
+}
+
+void quantum_coordinator::leave(quantum_member *member)
+{
+  members.erase(std::remove(members.begin(), members.end(), member),
+                members.end());
+  if (members.empty())
+  {
+    groups.erase(group);
+    delete this;
+  }
+}
+
+uint64_t quantum_coordinator::get_quantum() const
+{
+  return quantum;
+}
+
+void quantum_coordinator::recheck()
+{
+  barrier_evt.notify();
+}
+
+void quantum_coordinator::consume_wakeups()
+{
+  while (doorbell.try_wait());
+}
+
+void quantum_coordinator::barrier()
+{
+  if (!started)
+  {
+    for (size_t i = 0; i < members.size(); i++)
+    {
+      members[i]->wait_for_start();
+    }
+    started = true;
+  }
+
+  waiting = true;
+  while (__atomic_load_n(&finished, __ATOMIC_SEQ_CST) < members.size())
+  {
+    /*
+     * Never sleep on undrained IO: the CPU waiting for it would never finish.
+     * do_io() calls recheck() once it is done.
+     */
+    for (size_t i = 0; i < members.size(); i++)
+    {
+      if (members[i]->io_pending())
+      {
+        return;
+      }
+    }
+    if (__atomic_exchange_n(&interrupted, false, __ATOMIC_SEQ_CST))
+    {
+      return;
+    }
+    doorbell.wait();
+  }
+
+  /* Everybody is done: start the next quantum for all of them. */
+  waiting = false;
+  __atomic_store_n(&finished, 0, __ATOMIC_SEQ_CST);
+  barrier_evt.notify(quantum, sc_core::SC_NS);
+  for (size_t i = 0; i < members.size(); i++)
+  {
+    members[i]->start_quantum();
+  }
+}
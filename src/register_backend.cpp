@@ -0,0 +1,361 @@
+/*
+ * register_backend.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/register_backend.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+register_backend::register_backend(size_t combine_bytes):
+  combine_buffer(NULL),
+  combine_size(combine_bytes),
+  combine_start(0),
+  combine_len(0)
+{
+  if (combine_size)
+  {
+    combine_buffer = new uint8_t[combine_size];
+  }
+}
+
+register_backend::~register_backend()
+{
+  delete [] combine_buffer;
+}
+
+int register_backend::write(uint64_t address, const uint8_t *data,
+                            size_t len)
+{
+  int ret = 0;
+
+  if (!combine_size || !this->combinable(address, len))
+  {
+    /* Issued as it comes, after the writes gathered before it. */
+    ret = flush();
+    return ret | split_write(address, data, len);
+  }
+
+  /*
+   * Only strictly increasing addresses are gathered: two writes to the same
+   * register are never merged.
+   */
+  if (combine_len && (address != combine_start + combine_len
+                      || combine_len + len > combine_size))
+  {
+    ret = flush();
+  }
+
+  if (len > combine_size)
+  {
+    return ret | split_write(address, data, len);
+  }
+
+  if (!combine_len)
+  {
+    combine_start = address;
+  }
+  memcpy(combine_buffer + combine_len, data, len);
+  combine_len += len;
+  return ret;
+}
+
+int register_backend::read(uint64_t address, uint8_t *data, size_t len)
+{
+  int ret = flush();
+
+  return ret | split_read(address, data, len);
+}
+
+int register_backend::flush()
+{
+  int ret = 0;
+
+  if (combine_len)
+  {
+    ret = split_write(combine_start, combine_buffer, combine_len);
+    combine_len = 0;
+  }
+  return ret;
+}
+
+void register_backend::add_combine_range(uint64_t start, uint64_t end)
+{
+  combine_range range;
+
+  range.start = start;
+  range.end = end;
+  combine_ranges.push_back(range);
+}
+
+bool register_backend::combinable(uint64_t address, size_t len) const
+{
+  for (size_t i = 0; i < combine_ranges.size(); i++)
+  {
+    if (address >= combine_ranges[i].start
+        && address <= combine_ranges[i].end
+        && len - 1 <= combine_ranges[i].end - address)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static size_t access_width(uint64_t address, size_t len)
+{
+  size_t width = 8;
+
+  while (width > 1 && (width > len || (address & (width - 1))))
+  {
+    width >>= 1;
+  }
+  return width;
+}
+
+int register_backend::split_write(uint64_t address, const uint8_t *data,
+                                  size_t len)
+{
+  int ret = 0;
+
+  while (len)
+  {
+    size_t width = access_width(address, len);
+
+    ret |= raw_write(address, data, width);
+    address += width;
+    data += width;
+    len -= width;
+  }
+  return ret;
+}
+
+int register_backend::split_read(uint64_t address, uint8_t *data, size_t len)
+{
+  int ret = 0;
+
+  while (len)
+  {
+    size_t width = access_width(address, len);
+
+    ret |= raw_read(address, data, width);
+    address += width;
+    data += width;
+    len -= width;
+  }
+  return ret;
+}
+
+#if AWS_FPGA_PRESENT
+aws_register_backend::aws_register_backend(pci_bar_handle_t handle,
+                                           size_t combine_bytes):
+  register_backend(combine_bytes),
+  handle(handle)
+{
+
+}
+
+int aws_register_backend::raw_write(uint64_t address, const uint8_t *data,
+                                    size_t len)
+{
+  uint64_t value = 0;
+
+  memcpy(&value, data, len);
+  switch (len)
+  {
+    case 8:
+      return fpga_pci_poke64(handle, address, value);
+    case 4:
+      return fpga_pci_poke(handle, address, (uint32_t)value);
+    case 2:
+      /* No 16 bits access in the SDK. */
+      return fpga_pci_poke8(handle, address, data[0])
+           | fpga_pci_poke8(handle, address + 1, data[1]);
+    default:
+      /* Need aws-fpga sdk v1.4 to support 8 bit read and write. */
+      return fpga_pci_poke8(handle, address, data[0]);
+  }
+}
+
+int aws_register_backend::raw_read(uint64_t address, uint8_t *data,
+                                   size_t len)
+{
+  uint64_t value64;
+  uint32_t value32;
+  int ret;
+
+  switch (len)
+  {
+    case 8:
+      ret = fpga_pci_peek64(handle, address, &value64);
+      memcpy(data, &value64, len);
+      return ret;
+    case 4:
+      ret = fpga_pci_peek(handle, address, &value32);
+      memcpy(data, &value32, len);
+      return ret;
+    case 2:
+      return fpga_pci_peek8(handle, address, &data[0])
+           | fpga_pci_peek8(handle, address + 1, &data[1]);
+    default:
+      return fpga_pci_peek8(handle, address, &data[0]);
+  }
+}
+#endif
+
+#ifndef _WIN32
+mmap_register_backend::mmap_register_backend(const std::string& path,
+                                             uint64_t base, size_t size,
+                                             size_t combine_bytes):
+  register_backend(combine_bytes),
+  window(NULL),
+  base(base),
+  size(size)
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  /* Grow a fresh file to the window size, it reads as zero. */
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size < size)
+  {
+    if (ftruncate(fd, size) != 0)
+    {
+      close(fd);
+      return;
+    }
+  }
+
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map != MAP_FAILED)
+  {
+    window = (volatile uint8_t *)map;
+  }
+}
+
+mmap_register_backend::~mmap_register_backend()
+{
+  flush();
+  if (window)
+  {
+    munmap((void *)window, size);
+  }
+}
+
+bool mmap_register_backend::is_mapped() const
+{
+  return window != NULL;
+}
+
+int mmap_register_backend::raw_write(uint64_t address, const uint8_t *data,
+                                     size_t len)
+{
+  uint64_t offset = address - base;
+  uint64_t value = 0;
+
+  if (!window || address < base || offset + len > size)
+  {
+    return -1;
+  }
+
+  /* Single accesses of the requested width, like on the bus. */
+  memcpy(&value, data, len);
+  switch (len)
+  {
+    case 8:
+      *(volatile uint64_t *)(window + offset) = value;
+      break;
+    case 4:
+      *(volatile uint32_t *)(window + offset) = (uint32_t)value;
+      break;
+    case 2:
+      *(volatile uint16_t *)(window + offset) = (uint16_t)value;
+      break;
+    default:
+      *(window + offset) = (uint8_t)value;
+      break;
+  }
+  return 0;
+}
+
+int mmap_register_backend::raw_read(uint64_t address, uint8_t *data,
+                                    size_t len)
+{
+  uint64_t offset = address - base;
+  uint64_t value;
+
+  if (!window || address < base || offset + len > size)
+  {
+    return -1;
+  }
+
+  switch (len)
+  {
+    case 8:
+      value = *(volatile uint64_t *)(window + offset);
+      break;
+    case 4:
+      value = *(volatile uint32_t *)(window + offset);
+      break;
+    case 2:
+      value = *(volatile uint16_t *)(window + offset);
+      break;
+    default:
+      value = *(window + offset);
+      break;
+  }
+  memcpy(data, &value, len);
+  return 0;
+}
+#endif
@@ -0,0 +1,237 @@
+/*
+ * shadow_registers.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/shadow_registers.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define SHADOW_VALID 1
+#define SHADOW_DIRTY 2
+
+bool shadow_registers::add_range(uint64_t start, uint64_t end,
+                                 shadow_mode mode)
+{
+  std::vector<range>::iterator it = ranges.begin();
+  range r;
+
+  if (end < start || end - start >= max_range_size)
+  {
+    return false;
+  }
+  while (it != ranges.end() && it->start < start)
+  {
+    ++it;
+  }
+  /* A byte must have exactly one copy. */
+  if ((it != ranges.end() && it->start <= end)
+      || (it != ranges.begin() && (it - 1)->end >= start))
+  {
+    return false;
+  }
+
+  r.start = start;
+  r.end = end;
+  r.mode = mode;
+  r.data.resize(end - start + 1);
+  r.state.resize(end - start + 1);
+  ranges.insert(it, r);
+  return true;
+}
+
+shadow_registers::range *shadow_registers::lookup(uint64_t address,
+                                                  size_t size)
+{
+  size_t i;
+
+  /* Few ranges: a linear search beats anything fancier. */
+  for (i = 0; i < ranges.size() && ranges[i].start <= address; i++)
+  {
+    if (address <= ranges[i].end && size - 1 <= ranges[i].end - address)
+    {
+      return &ranges[i];
+    }
+  }
+  return NULL;
+}
+
+bool shadow_registers::read(uint64_t address, uint8_t *data, size_t size)
+{
+  range *r = this->lookup(address, size);
+  size_t offset;
+
+  if (!r)
+  {
+    return false;
+  }
+
+  offset = address - r->start;
+  for (size_t i = 0; i < size; i++)
+  {
+    if (!(r->state[offset + i] & SHADOW_VALID))
+    {
+      return false;
+    }
+  }
+  memcpy(data, &r->data[offset], size);
+  return true;
+}
+
+void shadow_registers::fill(uint64_t address, const uint8_t *data,
+                            size_t size)
+{
+  range *r = this->lookup(address, size);
+  size_t offset;
+
+  if (!r)
+  {
+    return;
+  }
+
+  /* Bytes written since are newer than what the target returned. */
+  offset = address - r->start;
+  for (size_t i = 0; i < size; i++)
+  {
+    if (!(r->state[offset + i] & SHADOW_DIRTY))
+    {
+      r->data[offset + i] = data[i];
+      r->state[offset + i] = SHADOW_VALID;
+    }
+  }
+}
+
+bool shadow_registers::write(uint64_t address, const uint8_t *data,
+                             size_t size)
+{
+  range *r = this->lookup(address, size);
+  shadow_write held;
+  size_t offset;
+
+  if (!r)
+  {
+    return false;
+  }
+
+  offset = address - r->start;
+  switch (r->mode)
+  {
+    case SHADOW_READ:
+      /* The target may not keep what was written. */
+      for (size_t i = 0; i < size; i++)
+      {
+        r->state[offset + i] &= ~SHADOW_VALID;
+      }
+      return false;
+    case SHADOW_WRITE_THROUGH:
+      this->fill(address, data, size);
+      return false;
+    case SHADOW_WRITE_BACK:
+      if (size > sizeof(held.data))
+      {
+        this->fill(address, data, size);
+        return false;
+      }
+      break;
+  }
+
+  memcpy(&r->data[offset], data, size);
+  for (size_t i = 0; i < size; i++)
+  {
+    r->state[offset + i] = SHADOW_VALID | SHADOW_DIRTY;
+  }
+
+  /* A register written again is flushed once, with its last value. */
+  for (size_t i = 0; i < dirty.size(); i++)
+  {
+    if (dirty[i].address == address && dirty[i].size == size)
+    {
+      return true;
+    }
+  }
+  held.address = address;
+  held.size = size;
+  dirty.push_back(held);
+  return true;
+}
+
+void shadow_registers::invalidate(uint64_t start, uint64_t end)
+{
+  for (size_t i = 0; i < ranges.size(); i++)
+  {
+    range& r = ranges[i];
+    uint64_t first;
+    uint64_t last;
+
+    if (start > r.end || end < r.start)
+    {
+      continue;
+    }
+    first = std::max(start, r.start) - r.start;
+    last = std::min(end, r.end) - r.start;
+    for (uint64_t offset = first; offset <= last; offset++)
+    {
+      /* A write not flushed yet stays: the CPU wrote after the change. */
+      if (!(r.state[offset] & SHADOW_DIRTY))
+      {
+        r.state[offset] = 0;
+      }
+    }
+  }
+}
+
+void shadow_registers::take_dirty(std::vector<shadow_write>& writes)
+{
+  writes.clear();
+  writes.swap(dirty);
+  for (size_t i = 0; i < writes.size(); i++)
+  {
+    range *r = this->lookup(writes[i].address, writes[i].size);
+    size_t offset = writes[i].address - r->start;
+
+    memcpy(writes[i].data, &r->data[offset], writes[i].size);
+    for (size_t j = 0; j < writes[i].size; j++)
+    {
+      r->state[offset + j] &= ~SHADOW_DIRTY;
+    }
+  }
+}
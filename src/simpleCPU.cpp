@@ -42,6 +42,11 @@
 
 #include "SimpleCPU/simpleCPU.h"
 #include "SimpleCPU/IRQ.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
 #if DEBUG_LOG
 static int const verb = SC_HIGH;
 #endif
@@ -52,27 +57,103 @@ static void _memory_bt(void *handle, Payload *p)
   _this->memory_bt(p);
 }
 
+static int _memory_burst(void *handle, Command cmd, uint64_t address,
+                         uint8_t *data, size_t len)
+{
+  SimpleCPU *_this = (SimpleCPU *)handle;
+  return _this->memory_burst(cmd, address, data, len);
+}
+
+static void _memory_issue(void *handle, Command cmd, uint64_t address,
+                          uint8_t *data, size_t len, uint64_t tag)
+{
+  SimpleCPU *_this = (SimpleCPU *)handle;
+  _this->memory_issue(cmd, address, data, len, tag);
+}
+
+static int _memory_collect(void *handle, uint64_t *tag, int *status, int wait)
+{
+  SimpleCPU *_this = (SimpleCPU *)handle;
+  ResponseStatus response_status;
+  int ret = _this->memory_collect(tag, &response_status, wait);
+
+  if (ret > 0)
+  {
+    *status = response_status;
+  }
+  return ret;
+}
+
 static int _memory_get_direct_mem_ptr(void *handle, Payload *p, DMIData *d)
 {
   SimpleCPU *_this = (SimpleCPU *)handle;
   return _this->memory_get_direct_mem_ptr(p, d);
 }
 
+/* Bursts carry a 32 bits length and need at least one byte. */
+static bool burst_length_valid(size_t len)
+{
+  return len && len == (uint32_t)len;
+}
+
 SimpleCPU::SimpleCPU(sc_core::sc_module_name name):
   TLM2CSCBridge(name),
   master_socket("iport"),
   irq_socket("interrupt_socket"),
+  irq_payload(NULL),
+  irq_batch_payload(NULL),
   kernel("kernel", ""),
   dtb("dtb", ""),
   rootfs("rootfs", ""),
   kernel_cmd("kernel_cmd", ""),
   GDBPort("gdb_port", (uint64_t)0),
   extraArguments("extra_arguments", ""),
+  posted_writes("posted_writes", false),
+  posted_write_depth("posted_write_depth", (uint64_t)8),
+  wait_policy_name("wait_policy", "block"),
+  wait_spin_count("wait_spin_count", (uint64_t)4000),
   quantum("quantum", 100000000),
+  quantum_adaptive("quantum_adaptive", false),
+  quantum_min("quantum_min", (uint64_t)100000),
+  quantum_max("quantum_max", (uint64_t)1000000000),
+  quantum_target_io("quantum_target_io", (uint64_t)16),
+  temporal_decoupling("temporal_decoupling", false),
+  shared_quantum("shared_quantum", false),
+  shared_quantum_group("shared_quantum_group", ""),
+  irq_coalesce("irq_coalesce", false),
+  irq_immediate("irq_immediate", ""),
+  shadow_ranges("shadow_registers", ""),
+  dmi_mtx(NULL),
   is_dmi(false),
   is_dmi_fpga(false),
   dmi_base_addr(0),
-  ptr(NULL)
+  dmi_sync("dmi_sync", "mutex"),
+  fpga_backend(NULL),
+  fpga_backend_type("fpga_backend", "aws"),
+  fpga_backend_file("fpga_backend_file", ""),
+  fpga_backend_base("fpga_backend_base", (uint64_t)0),
+  fpga_backend_size("fpga_backend_size", (uint64_t)0),
+  fpga_write_combine("fpga_write_combine", (uint64_t)0),
+  fpga_write_combine_ranges("fpga_write_combine_ranges", ""),
+  trace_file("trace_file", ""),
+  trace_start("trace_start", (uint64_t)0),
+  trace_end("trace_end", ~(uint64_t)0),
+  trace_sample("trace_sample", (uint64_t)1),
+  profile("profile", false),
+  profile_page_shift("profile_page_shift", (uint64_t)12),
+  profile_regions("profile_regions", ""),
+  profile_report("profile_report", ""),
+  profile_histograms("profile_histograms", false),
+  sync_stats_enable("sync_stats", false),
+  sync_stats_report("sync_stats_report", ""),
+  checkpoint_file("checkpoint_file", ""),
+  checkpoint_at("checkpoint_at", ~(uint64_t)0),
+  checkpoint_exit("checkpoint_exit", false),
+  restore_file("restore_file", ""),
+  restore_cow("restore_cow", false),
+  record_file("record_file", ""),
+  replay_file("replay_file", ""),
+  replay_local("replay_local", false)
 {
   master_socket.out_port(*this);
   /*
@@ -88,7 +169,12 @@ SimpleCPU::SimpleCPU(sc_core::sc_module_name name):
   SC_METHOD(quantum_notify);
   sensitive << quantum_evt;
   dont_initialize();
-  quantum_evt.notify(quantum, sc_core::SC_NS);
+  current_quantum = quantum;
+  quantum_io_count = 0;
+  quantum_irq_count = 0;
+  quantum_evt.notify(current_quantum, sc_core::SC_NS);
+  GC_REGISTER_TYPED_PARAM_CALLBACK(&quantum, gs::cnf::post_write, SimpleCPU,
+                                   quantum_changed);
 
   SC_METHOD(stop);
   sensitive << stop_evt;
@@ -97,23 +183,74 @@ SimpleCPU::SimpleCPU(sc_core::sc_module_name name):
   this->cpu_has_finished = false;
   this->systemc_has_finished = false;
   this->cpu_init = false;
-  this->DMIInvalidatePending = false;
+  this->cpu_running = false;
+  this->cpu_stopped = false;
+  this->decoupled = temporal_decoupling;
+  this->quantum_base_ps = 0;
+  this->local_offset_ps = 0;
+  this->quantum_expired = false;
+  this->checkpoint_taken = false;
+  this->dmi_invalidate_epoch = 0;
+  this->dmi_applied_epoch = 0;
+  pthread_mutex_init(&dmi_invalidate_mtx, NULL);
+
+  std::string sync = dmi_sync;
+  if (sync == "mutex")
+  {
+    dmi_lock_free = false;
+  }
+  else if (sync == "atomic")
+  {
+    dmi_lock_free = true;
+  }
+  else
+  {
+    SC_REPORT_ERROR(this->name(), ("Unknown dmi_sync '" + sync + "':\n"
+                                   "Use 'mutex' or 'atomic'.").c_str());
+  }
+  dmi_seq = 0;
 
+  init_wait_policy();
+  init_fpga_backend();
   init_io();
   init_systemc_sleep();
   init_cpu_sleep();
-
-#if REGISTER_ACCESS_TRACE
-  //Open the performance log when vp starts.
-  fout.open("./performance.log");
-#endif
+  init_recording();
+  /* Nothing to restore a replay into. */
+  restore_pending = !((std::string)restore_file).empty() && !replay;
+  init_shared_quantum();
+  init_irq();
+  init_shadow();
+
+  init_tracer();
+  init_profiler();
+  init_sync_stats();
 }
 
 SimpleCPU::~SimpleCPU()
 {
-  destroy_io();
-  destroy_systemc_sleep();
-  destroy_cpu_sleep();
+  GC_UNREGISTER_CALLBACKS();
+  if (coordinator)
+  {
+    coordinator->leave(this);
+  }
+  delete replay;
+  delete recorder;
+  delete irq_front;
+  delete shadow;
+  delete handoff_stats;
+  delete profiler;
+  delete tracer;
+  delete fpga_backend;
+  if (irq_payload)
+  {
+    payload_destroy(irq_payload);
+  }
+  if (irq_batch_payload)
+  {
+    payload_destroy(irq_batch_payload);
+  }
+  pthread_mutex_destroy(&dmi_invalidate_mtx);
 }
 
 void SimpleCPU::set_dmi_mutex(pthread_mutex_t *mtx, bool is_fpga)
@@ -136,12 +273,308 @@ void SimpleCPU::set_dmi_mutex_fpga(pthread_mutex_t *mtx) //Set the lock pointer
   is_dmi_fpga = true;
 }
 
+void SimpleCPU::dmi_write_begin()
+{
+  if (dmi_mtx)
+  {
+    pthread_mutex_lock(dmi_mtx);
+  }
+  /* Odd while the memory is being updated. */
+  __atomic_add_fetch(&dmi_seq, 1, __ATOMIC_ACQ_REL);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void SimpleCPU::dmi_write_end()
+{
+  __atomic_add_fetch(&dmi_seq, 1, __ATOMIC_RELEASE);
+  if (dmi_mtx)
+  {
+    pthread_mutex_unlock(dmi_mtx);
+  }
+}
+
+void SimpleCPU::init_fpga_backend()
+{
+  std::string type = fpga_backend_type;
+#ifndef _WIN32
+  mmap_register_backend *backend;
+#endif
+
+  /* The aws backend is created by set_pci_bar_handle. */
+  if (type == "aws")
+  {
+    return;
+  }
+
+#ifndef _WIN32
+  if (type != "mmap")
+  {
+    SC_REPORT_ERROR(name(), ("Unknown fpga_backend '" + type + "':\n"
+                             "Use 'aws' or 'mmap'.").c_str());
+    return;
+  }
+
+  backend = new mmap_register_backend(fpga_backend_file, fpga_backend_base,
+                                      fpga_backend_size, fpga_write_combine);
+  if (!backend->is_mapped())
+  {
+    delete backend;
+    SC_REPORT_ERROR(name(), ("Can't map fpga_backend_file '"
+                             + (std::string)fpga_backend_file + "'.").c_str());
+    return;
+  }
+  init_write_combine(backend);
+  fpga_backend = backend;
+  is_dmi_fpga = true;
+#else
+  SC_REPORT_ERROR(name(), ("Unknown fpga_backend '" + type + "':\n"
+                           "Use 'aws'.").c_str());
+#endif
+}
+
+void SimpleCPU::init_write_combine(register_backend *backend)
+{
+  std::string ranges = fpga_write_combine_ranges;
+  size_t pos = 0;
+  char *end;
+
+  if (fpga_write_combine && ranges.empty())
+  {
+    SC_REPORT_WARNING(name(), "fpga_write_combine is ignored without "
+                              "fpga_write_combine_ranges.");
+  }
+
+  /* "start-end,start-end", both ends included. */
+  while (pos < ranges.size())
+  {
+    const char *range = ranges.c_str() + pos;
+    uint64_t start = strtoull(range, &end, 0);
+    uint64_t last;
+
+    if (*end != '-')
+    {
+      break;
+    }
+    last = strtoull(end + 1, &end, 0);
+    if ((*end != ',' && *end != '\0') || last < start)
+    {
+      break;
+    }
+    backend->add_combine_range(start, last);
+    pos = end - ranges.c_str() + (*end == ',');
+  }
+
+  if (pos < ranges.size())
+  {
+    SC_REPORT_ERROR(name(), ("Malformed fpga_write_combine_ranges '" + ranges
+                             + "':\nUse 'start-end,start-end'.").c_str());
+  }
+}
+
+void SimpleCPU::init_tracer()
+{
+  std::string file = trace_file;
+
+  tracer = NULL;
+  if (file.empty())
+  {
+    return;
+  }
+
+  tracer = new access_tracer();
+  tracer->set_filter(trace_start, trace_end);
+  tracer->set_sampling(trace_sample);
+  if (!tracer->open(file))
+  {
+    delete tracer;
+    tracer = NULL;
+    SC_REPORT_ERROR(name(), ("Can't open trace_file '" + file + "'.").c_str());
+  }
+}
+
+void SimpleCPU::trace_access(uint64_t address, uint64_t value, uint64_t size,
+                             Command cmd, bool posted, uint64_t start_ns)
+{
+  access_trace_record record;
+
+  record.host_ns = start_ns;
+  record.sc_ps = sc_core::sc_time_stamp().value();
+  record.address = address;
+  record.value = value;
+  record.latency_ns = host_time_ns() - start_ns;
+  record.size = std::min(size, (uint64_t)0xFFFF);
+  record.is_write = (cmd == WRITE);
+  record.posted = posted;
+  tracer->record(record);
+}
+
+void SimpleCPU::trace_burst(uint64_t address, const uint8_t *data,
+                            uint64_t size, Command cmd, uint64_t start_ns)
+{
+  uint64_t value = 0;
+
+  memcpy(&value, data, std::min(size, (uint64_t)sizeof(value)));
+  this->trace_access(address, value, size, cmd, false, start_ns);
+}
+
+void SimpleCPU::init_profiler()
+{
+  std::string ranges = profile_regions;
+  size_t pos = 0;
+  char *end;
+
+  profiler = NULL;
+  if (!profile)
+  {
+    return;
+  }
+
+  if (profile_page_shift > 63)
+  {
+    SC_REPORT_ERROR(name(), "profile_page_shift must be lower than 64.");
+    return;
+  }
+  profiler = new mmio_profiler(profile_page_shift);
+
+  /* "start-end,start-end", both ends included. */
+  while (pos < ranges.size())
+  {
+    const char *range = ranges.c_str() + pos;
+    uint64_t start = strtoull(range, &end, 0);
+    uint64_t last;
+
+    if (*end != '-')
+    {
+      break;
+    }
+    last = strtoull(end + 1, &end, 0);
+    if ((*end != ',' && *end != '\0') || last < start)
+    {
+      break;
+    }
+    if (!profiler->add_region(start, last))
+    {
+      SC_REPORT_ERROR(name(), ("Overlapping profile_regions '" + ranges
+                               + "'.").c_str());
+      return;
+    }
+    pos = end - ranges.c_str() + (*end == ',');
+  }
+
+  if (pos < ranges.size())
+  {
+    SC_REPORT_ERROR(name(), ("Malformed profile_regions '" + ranges + "':\n"
+                             "Use 'start-end,start-end'.").c_str());
+  }
+}
+
+void SimpleCPU::dump_profile(std::ostream& os, bool histograms)
+{
+  if (profiler)
+  {
+    profiler->report(os, histograms);
+  }
+}
+
+void SimpleCPU::report_profile()
+{
+  std::string path = profile_report;
+
+  if (!profiler)
+  {
+    return;
+  }
+
+  if (path.empty())
+  {
+    this->dump_profile(std::cout, profile_histograms);
+    return;
+  }
+
+  std::ofstream report(path.c_str());
+  if (!report.is_open())
+  {
+    SC_REPORT_WARNING(name(), ("Can't open profile_report '" + path
+                               + "'.").c_str());
+    return;
+  }
+  this->dump_profile(report, profile_histograms);
+}
+
+void SimpleCPU::init_sync_stats()
+{
+  handoff_stats = NULL;
+  if (!sync_stats_enable)
+  {
+    return;
+  }
+
+  handoff_stats = new sync_stats();
+  cpu_wakeup.set_stats(&handoff_stats->cpu_sleep);
+  systemc_wakeup.set_stats(&handoff_stats->systemc_sleep);
+  io_done.set_stats(&handoff_stats->io_wait);
+  cpu_started.set_stats(&handoff_stats->cpu_init);
+  quantum_start_ns = 0;
+  quantum_io_start_ns = 0;
+  dmi_locked_ns = 0;
+}
+
+const sync_stats *SimpleCPU::get_sync_stats() const
+{
+  return handoff_stats;
+}
+
+void SimpleCPU::dump_sync_stats(std::ostream& os)
+{
+  if (handoff_stats)
+  {
+    handoff_stats->print(os);
+  }
+}
+
+void SimpleCPU::report_sync_stats()
+{
+  std::string path = sync_stats_report;
+
+  if (!handoff_stats)
+  {
+    return;
+  }
+
+  if (path.empty())
+  {
+    this->dump_sync_stats(std::cout);
+    return;
+  }
+
+  std::ofstream report(path.c_str());
+  if (!report.is_open())
+  {
+    SC_REPORT_WARNING(name(), ("Can't open sync_stats_report '" + path
+                               + "'.").c_str());
+    return;
+  }
+  this->dump_sync_stats(report);
+}
+
 void SimpleCPU::set_dmi_base_addr(uint64_t addr)
 {
   dmi_base_addr = addr;
   std::cout << "RAM base address: 0x" << std::hex << addr << endl;
 }
 
+void SimpleCPU::set_posted_write_error_callback(posted_write_error_cb cb,
+                                                void *opaque)
+{
+  posted_error_opaque = opaque;
+  posted_error_cb = cb;
+}
+
+uint64_t SimpleCPU::get_posted_write_errors() const
+{
+  return __atomic_load_n(&posted_write_errors, __ATOMIC_RELAXED);
+}
+
 void SimpleCPU::additional_init()
 {
   /*
@@ -183,12 +616,27 @@ void SimpleCPU::additional_init()
 
   tlm2c_bind(this->initiatorSocket, remote_target);
   tlm2c_bind(remote_initiator, this->targetSocket);
+
+  this->irq_payload = payload_create();
+  payload_set_command(this->irq_payload, WRITE);
+  this->irq_batch_payload = payload_create();
+  payload_set_command(this->irq_batch_payload, WRITE);
+
+  this->extensions.handler = this;
+  this->extensions.memory_burst = _memory_burst;
+  this->extensions.memory_issue = _memory_issue;
+  this->extensions.memory_collect = _memory_collect;
 }
 
 void SimpleCPU::end_of_elaboration()
 {
-  /* Create transaction. */
-  transaction = master_socket.create_transaction();
+  /* Create the transaction pool. */
+  for (uint32_t i = 0; i < io_ring_size; i++)
+  {
+    io_pool[i].transaction = master_socket.create_transaction();
+    io_pool[i].buffer = NULL;
+    io_pool[i].size = 0;
+  }
 }
 
 void SimpleCPU::memory_bt(Payload *payload)
@@ -201,45 +649,63 @@ void SimpleCPU::memory_bt(Payload *payload)
   uint64_t value = payload_get_value(p);
   uint64_t size = payload_get_size(p);
   Command cmd = payload_get_command(p);
-  gs::GSDataType::dtype data = gs::GSDataType::dtype((unsigned char *)&value,
-                                                     size);
-
-  /* Fill the transaction. */
-  this->transaction->reset();
-  this->transaction->setMBurstLength(size);
-  this->transaction->setMAddr(address);
-  this->transaction->setMData(data);
-  if (cmd == READ)
+  const dmi_region *region;
+  uint64_t start_ns = profiler ? host_time_ns() : 0;
+
+  this->check_dmi_invalidations();
+  this->check_irqs();
+
+  /* Served from the shadow registers, no transaction. */
+  if (shadow && ((cmd == READ && shadow->read(address, (uint8_t *)&value,
+                                              size))
+                 || (cmd == WRITE && shadow->write(address,
+                                                   (uint8_t *)&value, size))))
+  {
+    if (cmd == READ)
+    {
+      payload_set_value(p, value);
+    }
+    if (recorder)
+    {
+      this->record_access(cmd, address, (uint8_t *)&value, size,
+                          TRAFFIC_ROUTE_SHADOW, OK_RESPONSE,
+                          this->access_time_ps(), 0);
+    }
+    payload_set_response_status(p, OK_RESPONSE);
+    return;
+  }
+
+  /* Anything else reaches the target after the writes held back. */
+  if (shadow && shadow->is_dirty())
   {
-    this->transaction->setMCmd(gs::Generic_MCMD_RD);
+    this->flush_shadow();
   }
-  else if (cmd == WRITE)
+
+  /* A read must observe every write posted before it. */
+  if (cmd == READ)
   {
-    this->transaction->setMCmd(gs::Generic_MCMD_WR);
+    this->io_barrier();
   }
 
-  if (is_dmi_fpga && (address > dmi_base_addr)) 
+  if (is_dmi_fpga && fpga_backend && (address > dmi_base_addr))
   {
-#if AWS_FPGA_PRESENT
-        // Issue request
-    uint64_t addr_fpga = address;
     if (cmd == WRITE) {
-      if (0 != data_write(addr_fpga, reinterpret_cast<uint8_t *>(&value), static_cast<int>(size))) {
+      if (0 != fpga_backend->write(address, reinterpret_cast<uint8_t *>(&value), static_cast<int>(size))) {
         SC_REPORT_ERROR(name(), "ERROR on data write!\n");
       } else {
 #if DEBUG_LOG
         std::ostringstream oss;
-        oss << "CPU: iswrite=1 addr=0x" << std::hex << addr_fpga << std::dec << " len=" << size << " data=0x " << std::hex << *(reinterpret_cast<uint32_t *>(&value)) << std::endl;
+        oss << "CPU: iswrite=1 addr=0x" << std::hex << address << std::dec << " len=" << size << " data=0x " << std::hex << *(reinterpret_cast<uint32_t *>(&value)) << std::endl;
         SC_REPORT_INFO_VERB(name(), oss.str().c_str(), verb);
 #endif
       }
     } else {
-      if (0 != data_read(addr_fpga, reinterpret_cast<uint8_t *>(&value),static_cast<int>(size))) {
+      if (0 != fpga_backend->read(address, reinterpret_cast<uint8_t *>(&value), static_cast<int>(size))) {
         SC_REPORT_ERROR(name(), "ERROR on data read!\n");
       } else {
 #if DEBUG_LOG
         std::ostringstream oss;
-        oss << "CPU: iswrite=0 addr=0x" << std::hex << addr_fpga << std::dec << " len=" << size << " data=0x " << std::hex << *(reinterpret_cast<uint32_t *>(&value)) << std::endl;
+        oss << "CPU: iswrite=0 addr=0x" << std::hex << address << std::dec << " len=" << size << " data=0x " << std::hex << *(reinterpret_cast<uint32_t *>(&value)) << std::endl;
         SC_REPORT_INFO_VERB(name(), oss.str().c_str(), verb);
 #endif
       }
@@ -249,317 +715,1886 @@ void SimpleCPU::memory_bt(Payload *payload)
       payload_set_value(p, value);
     }
 
-    payload_set_response_status(p, OK_RESPONSE);
-#endif
-  } else if (is_dmi && (address > dmi_base_addr)) {
-    if (ptr == NULL)
+    if (profiler)
     {
-      DMIData dmi;
-      memory_get_direct_mem_ptr(payload, &dmi);
-      ptr = (uint64_t *)(dmi.pointer);
+      this->profile_access(address, size, cmd, MMIO_ROUTE_FPGA, start_ns, 0);
     }
+    if (recorder)
+    {
+      this->record_access(cmd, address, (uint8_t *)&value, size,
+                          TRAFFIC_ROUTE_FPGA, OK_RESPONSE,
+                          this->access_time_ps(), 0);
+    }
+    payload_set_response_status(p, OK_RESPONSE);
+  } else if (is_dmi && (region = dmi_lookup(address, size, cmd))) {
+    uint8_t *host = region->pointer + (address - region->start);
 
-    pthread_mutex_lock(dmi_mtx);
-
-    uint64_t offset = address - dmi_base_addr;
     switch (cmd)
     {
         case READ:
-          memcpy((uint8_t *)&value, &(((uint8_t *)ptr)[offset]), size);
+          dmi_copy_from(host, (uint8_t *)&value, size);
           break;
         case WRITE:
-          memcpy(&(((uint8_t *)ptr)[offset]), (uint8_t *)&value, size);
+          dmi_copy_to(host, (uint8_t *)&value, size);
           break;
         default:
           std::cout << "error invalid command type" << std::endl;
           break;
     }
 
-    pthread_mutex_unlock(dmi_mtx);
-
     if (cmd == READ)
     {
       payload_set_value(p, value);
     }
 
+    if (profiler)
+    {
+      /* SystemC time is what the target annotated on the DMI. */
+      this->profile_access(address, size, cmd, MMIO_ROUTE_DMI, start_ns,
+                           (cmd == READ) ? region->read_latency.value()
+                                         : region->write_latency.value());
+    }
+    if (recorder)
+    {
+      this->record_access(cmd, address, (uint8_t *)&value, size,
+                          TRAFFIC_ROUTE_DMI, OK_RESPONSE,
+                          this->access_time_ps(), 0);
+    }
     payload_set_response_status(p, OK_RESPONSE);
+    if (decoupled)
+    {
+      this->advance_local_time_ps((cmd == READ) ? region->read_latency.value()
+                                        : region->write_latency.value());
+    }
   } else {
+    io_request request;
+    io_response response;
+    bool tracing = tracer && tracer->wants(address);
+
+    if (tracing && !profiler)
+    {
+      start_ns = host_time_ns();
+    }
+
+    request.address = address;
+    request.value = (cmd == READ) ? 0 : value;
+    request.data = NULL;
+    request.size = size;
+    request.cmd = cmd;
+    request.posted = (cmd == WRITE) && posted_depth;
+    request.nb = false;
+    request.want_dmi = this->dmi_wanted(address);
+    request.dmi_only = false;
+    request.traced = false;
+    request.local_ps = decoupled ? this->local_time_ps() : 0;
+
+    if (request.posted)
+    {
+      /* Don't wait: errors are reported by retire_posted_write(). */
+      this->post_a_write(request);
+      if (tracing)
+      {
+        this->trace_access(address, value, size, cmd, true, start_ns);
+      }
+      if (recorder)
+      {
+        this->record_access(cmd, address, (uint8_t *)&value, size,
+                            TRAFFIC_ROUTE_TRANSACTION, OK_RESPONSE,
+                            this->access_time_ps(),
+                            TRAFFIC_FLAG_POSTED | TRAFFIC_FLAG_STATUS_UNKNOWN);
+      }
+      payload_set_response_status(p, OK_RESPONSE);
+      return;
+    }
+
     /* Ask SystemC to do the transaction. */
-    this->post_a_transaction();
+    this->post_a_transaction(request, &response);
 
     if (cmd == READ)
     {
-      value = *((uint32_t *)data.getData());
+      value = response.value;
       payload_set_value(p, value);
+      if (shadow && response.status == OK_RESPONSE)
+      {
+        shadow->fill(address, (uint8_t *)&value, size);
+      }
     }
 
-#if REGISTER_ACCESS_TRACE
-    if (address<=0xc0000000)
+    if (tracing)
     {
-        clock_t now_clk;
-        now_clk = clock();
-        if(cmd == READ)
-            fout << "[ "<<setprecision(10)<<((float)now_clk/CLOCKS_PER_SEC) << " s ] " <<"CPU: iswrite=0 Read addr=0x" << std::hex <<address <<"  data=0x"<<std::hex<<value<<std::endl;
-        else
-            fout << "[ "<<setprecision(10)<<((float)now_clk/CLOCKS_PER_SEC) << " s ] " <<"CPU: iswrite=1 Write addr=0x" << std::hex <<address <<"  data=0x"<<std::hex<<value<<std::endl;
+      this->trace_access(address, value, size, cmd, false, start_ns);
     }
-#endif
-
-    if (this->transaction->getSResp() == gs::Generic_SRESP_ERR)
+    if (profiler)
     {
-      payload_set_response_status(p, ADDRESS_ERROR_RESPONSE);
+      this->profile_access(address, size, cmd, MMIO_ROUTE_TRANSACTION,
+                           start_ns, response.sc_ps);
     }
-    else
+    if (recorder)
     {
-      payload_set_response_status(p, OK_RESPONSE);
+      /* Stamped with the SystemC time the transaction started at. */
+      this->record_access(cmd, address, (uint8_t *)&value, size,
+                          TRAFFIC_ROUTE_TRANSACTION, response.status,
+                          response.done_ps - response.sc_ps, 0);
+    }
+
+    payload_set_response_status(p, response.status);
+    if (decoupled)
+    {
+      this->advance_local_time_ps(response.time_ps);
     }
   }
 }
 
-int SimpleCPU::memory_get_direct_mem_ptr(Payload *p, DMIData *d)
+ResponseStatus SimpleCPU::memory_burst(Command cmd, uint64_t address,
+                                       uint8_t *data, size_t len)
 {
-  uint64_t address = payload_get_address((GenericPayload *)p);
+  const dmi_region *region;
+  io_request request;
+  io_response response;
+  uint64_t start_ns = profiler ? host_time_ns() : 0;
 
-  tlm::tlm_generic_payload payload;
-  tlm::tlm_dmi dmi_data;
+  if (!burst_length_valid(len))
+  {
+    return GENERIC_ERROR_RESPONSE;
+  }
 
-  payload.set_address(address);
-  if (this->master_socket->get_direct_mem_ptr(payload, dmi_data))
+  this->check_dmi_invalidations();
+  this->check_irqs();
+  this->shadow_barrier(cmd, address, len);
+
+  if (cmd == READ)
   {
-    d->pointer = dmi_data.get_dmi_ptr();
-    return 1;
+    this->io_barrier();
   }
-  else
+
+  if (is_dmi_fpga && fpga_backend && (address > dmi_base_addr))
   {
-    return 0;
+    int failed = (cmd == WRITE) ? fpga_backend->write(address, data, len)
+                                : fpga_backend->read(address, data, len);
+    if (failed)
+    {
+      SC_REPORT_ERROR(name(), "ERROR on burst access!\n");
+      return GENERIC_ERROR_RESPONSE;
+    }
+    if (profiler)
+    {
+      this->profile_access(address, len, cmd, MMIO_ROUTE_FPGA, start_ns, 0);
+    }
+    if (recorder)
+    {
+      this->record_access(cmd, address, data, len, TRAFFIC_ROUTE_FPGA,
+                          OK_RESPONSE, this->access_time_ps(), 0);
+    }
+    return OK_RESPONSE;
   }
-}
 
-void SimpleCPU::memory_invalidate_direct_mem_ptr(unsigned int index,
-                                                 sc_dt::uint64 start,
-                                                 sc_dt::uint64 end)
-{
-    this->DMIInvalidatePending = true;
-    this->DMIInvalidateStart = start;
-    this->DMIInvalidateEnd = end;
+  if (is_dmi && (region = dmi_lookup(address, len, cmd)))
+  {
+    /* The whole burst is inside one region: a single copy. */
+    uint8_t *host = region->pointer + (address - region->start);
+
+    if (cmd == READ)
+    {
+      dmi_copy_from(host, data, len);
+    }
+    else
+    {
+      dmi_copy_to(host, data, len);
+    }
+    if (profiler)
+    {
+      this->profile_access(address, len, cmd, MMIO_ROUTE_DMI, start_ns,
+                           (cmd == READ) ? region->read_latency.value()
+                                         : region->write_latency.value());
+    }
+    if (recorder)
+    {
+      this->record_access(cmd, address, data, len, TRAFFIC_ROUTE_DMI,
+                          OK_RESPONSE, this->access_time_ps(), 0);
+    }
+    if (decoupled)
+    {
+      this->advance_local_time_ps((cmd == READ) ? region->read_latency.value()
+                                        : region->write_latency.value());
+    }
+    return OK_RESPONSE;
+  }
+
+  bool tracing = tracer && tracer->wants(address);
+
+  if (tracing && !profiler)
+  {
+    start_ns = host_time_ns();
+  }
+
+  /*
+   * One transaction for the whole buffer. It is never posted: the buffer
+   * belongs to the caller and is only valid until we return.
+   */
+  request.address = address;
+  request.value = 0;
+  request.data = data;
+  request.size = len;
+  request.cmd = cmd;
+  request.posted = false;
+  request.nb = false;
+  request.want_dmi = this->dmi_wanted(address);
+  request.dmi_only = false;
+  request.traced = false;
+  request.local_ps = decoupled ? this->local_time_ps() : 0;
+  this->post_a_transaction(request, &response);
+  if (tracing)
+  {
+    this->trace_burst(address, data, len, cmd, start_ns);
+  }
+  if (profiler)
+  {
+    this->profile_access(address, len, cmd, MMIO_ROUTE_TRANSACTION, start_ns,
+                         response.sc_ps);
+  }
+  if (recorder)
+  {
+    this->record_access(cmd, address, data, len, TRAFFIC_ROUTE_TRANSACTION,
+                        response.status, response.done_ps - response.sc_ps,
+                        0);
+  }
+  if (decoupled)
+  {
+    this->advance_local_time_ps(response.time_ps);
+  }
+  return response.status;
+}
+
+void SimpleCPU::memory_issue(Command cmd, uint64_t address, uint8_t *data,
+                             size_t len, uint64_t tag)
+{
+  io_request request;
+  io_response completion;
+
+  this->check_dmi_invalidations();
+
+  if (!burst_length_valid(len)
+      || (is_dmi_fpga && fpga_backend && (address > dmi_base_addr))
+      || (is_dmi && dmi_lookup(address, len, cmd)))
+  {
+    /*
+     * Nothing to overlap with: done in place and completed at once. A bad
+     * length completes with the error memory_burst() returns for it.
+     */
+    completion.address = address;
+    completion.value = 0;
+    completion.data = data;
+    completion.size = len;
+    completion.status = this->memory_burst(cmd, address, data, len);
+    completion.cmd = cmd;
+    completion.posted = false;
+    completion.host_ns = 0;
+    completion.sc_ps = 0;
+    completion.done_ps = 0;
+    completion.time_ps = 0;
+    completion.nb = true;
+    completion.tag = tag;
+    completion.has_dmi = false;
+    completion.traced = false;
+    nb_completions.push_back(completion);
+    return;
+  }
+
+  this->check_irqs();
+  this->shadow_barrier(cmd, address, len);
+
+  request.address = address;
+  request.value = 0;
+  request.data = data;
+  request.size = len;
+  request.cmd = cmd;
+  request.posted = false;
+  request.nb = true;
+  request.tag = tag;
+  request.want_dmi = this->dmi_wanted(address);
+  request.dmi_only = false;
+  /* Traced when it retires, like it is profiled. */
+  request.traced = tracer && tracer->wants(address);
+  request.start_ns = request.traced ? host_time_ns() : 0;
+  request.local_ps = decoupled ? this->local_time_ps() : 0;
+
+  /* Like post_a_transaction() without waiting. */
+  this->queue_io(request, io_ring_size);
+  nb_in_flight++;
+  this->announce_io(posted_unsent + 1);
+}
+
+int SimpleCPU::memory_collect(uint64_t *tag, ResponseStatus *status,
+                              bool wait)
+{
+  io_response response;
+
+  while (nb_completions.empty())
+  {
+    if (!nb_in_flight)
+    {
+      return -1;
+    }
+    if (wait)
+    {
+      io_done.wait();
+    }
+    else if (!io_done.try_wait())
+    {
+      return 0;
+    }
+    this->pop_io_response(&response);
+    this->retire_response(response);
+  }
+
+  response = nb_completions.front();
+  nb_completions.pop_front();
+  *tag = response.tag;
+  *status = response.status;
+  if (decoupled)
+  {
+    this->advance_local_time_ps(response.time_ps);
+  }
+  return 1;
+}
+
+int SimpleCPU::memory_get_direct_mem_ptr(Payload *p, DMIData *d)
+{
+  uint64_t address = payload_get_address((GenericPayload *)p);
+  const dmi_region *region = dmi_regions.lookup(address);
+  io_request request;
+  io_response response;
+
+  if (!region)
+  {
+    /* Only SystemC can ask the target: the region comes with the response. */
+    request.address = address;
+    request.value = 0;
+    request.data = NULL;
+    request.size = 0;
+    request.cmd = READ;
+    request.posted = false;
+    request.nb = false;
+    request.tag = 0;
+    request.want_dmi = true;
+    request.dmi_only = true;
+    request.traced = false;
+    request.local_ps = 0;
+    this->post_a_transaction(request, &response);
+    region = dmi_regions.lookup(address);
+  }
+
+  if (region && region->pointer)
+  {
+    d->pointer = region->pointer;
+    return 1;
+  }
+  else
+  {
+    return 0;
+  }
+}
+
+dmi_region SimpleCPU::acquire_dmi_region(uint64_t address)
+{
+  tlm::tlm_generic_payload payload;
+  tlm::tlm_dmi dmi_data;
+  dmi_region region;
+
+  payload.set_address(address);
+  if (this->master_socket->get_direct_mem_ptr(payload, dmi_data))
+  {
+    region.start = dmi_data.get_start_address();
+    region.end = dmi_data.get_end_address();
+    region.pointer = dmi_data.get_dmi_ptr();
+    region.read_allowed = dmi_data.is_read_allowed();
+    region.write_allowed = dmi_data.is_write_allowed();
+    region.read_latency = dmi_data.get_read_latency();
+    region.write_latency = dmi_data.get_write_latency();
+  }
+  else
+  {
+    /*
+     * Remember the refusal so the next access doesn't ask again. Targets often
+     * leave the whole address space in a refused tlm_dmi: only cache the page
+     * around the address.
+     */
+    region.start = std::max((uint64_t)dmi_data.get_start_address(),
+                            address & ~dmi_refusal_mask);
+    region.end = std::min((uint64_t)dmi_data.get_end_address(),
+                          address | dmi_refusal_mask);
+    region.pointer = NULL;
+    region.read_allowed = false;
+    region.write_allowed = false;
+  }
+
+  return region;
+}
+
+bool SimpleCPU::dmi_wanted(uint64_t address)
+{
+  /* Only when nothing is known: a refusal is cached as well. */
+  return is_dmi && !dmi_regions.lookup(address);
+}
+
+static bool dmi_atomic_access(const uint8_t *host, uint64_t size)
+{
+  return (size == 1 || size == 2 || size == 4 || size == 8)
+      && !((uintptr_t)host & (size - 1));
+}
+
+void SimpleCPU::dmi_copy_from(const uint8_t *host, uint8_t *data,
+                              uint64_t size)
+{
+  uint32_t seq;
+
+  if (!dmi_lock_free)
+  {
+    this->dmi_lock();
+    memcpy(data, host, size);
+    this->dmi_unlock();
+    return;
+  }
+
+  switch (dmi_atomic_access(host, size) ? size : 0)
+  {
+    case 1:
+      *data = __atomic_load_n(host, __ATOMIC_RELAXED);
+      return;
+    case 2:
+      {
+        uint16_t v = __atomic_load_n((const uint16_t *)host, __ATOMIC_RELAXED);
+        memcpy(data, &v, size);
+      }
+      return;
+    case 4:
+      {
+        uint32_t v = __atomic_load_n((const uint32_t *)host, __ATOMIC_RELAXED);
+        memcpy(data, &v, size);
+      }
+      return;
+    case 8:
+      {
+        uint64_t v = __atomic_load_n((const uint64_t *)host, __ATOMIC_RELAXED);
+        memcpy(data, &v, size);
+      }
+      return;
+    default:
+      break;
+  }
+
+  /* Anything else is retried until no bulk update overlapped the copy. */
+  do
+  {
+    while ((seq = __atomic_load_n(&dmi_seq, __ATOMIC_ACQUIRE)) & 1)
+    {
+      sync_cpu_relax();
+    }
+    memcpy(data, host, size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&dmi_seq, __ATOMIC_RELAXED) != seq);
+}
+
+void SimpleCPU::dmi_copy_to(uint8_t *host, const uint8_t *data,
+                            uint64_t size)
+{
+  if (!dmi_lock_free)
+  {
+    this->dmi_lock();
+    memcpy(host, data, size);
+    this->dmi_unlock();
+    return;
+  }
+
+  switch (dmi_atomic_access(host, size) ? size : 0)
+  {
+    case 1:
+      __atomic_store_n(host, *data, __ATOMIC_RELAXED);
+      return;
+    case 2:
+      {
+        uint16_t v;
+        memcpy(&v, data, size);
+        __atomic_store_n((uint16_t *)host, v, __ATOMIC_RELAXED);
+      }
+      return;
+    case 4:
+      {
+        uint32_t v;
+        memcpy(&v, data, size);
+        __atomic_store_n((uint32_t *)host, v, __ATOMIC_RELAXED);
+      }
+      return;
+    case 8:
+      {
+        uint64_t v;
+        memcpy(&v, data, size);
+        __atomic_store_n((uint64_t *)host, v, __ATOMIC_RELAXED);
+      }
+      return;
+    default:
+      break;
+  }
+
+  /* Unaligned or odd sized: behave like a bulk update. */
+  dmi_write_begin();
+  memcpy(host, data, size);
+  dmi_write_end();
+}
+
+void SimpleCPU::dmi_lock()
+{
+  uint64_t start_ns;
+
+  if (!handoff_stats)
+  {
+    pthread_mutex_lock(dmi_mtx);
+    return;
+  }
+
+  handoff_stats->dmi_lock.acquisitions++;
+  if (pthread_mutex_trylock(dmi_mtx))
+  {
+    start_ns = host_time_ns();
+    pthread_mutex_lock(dmi_mtx);
+    dmi_locked_ns = host_time_ns();
+    handoff_stats->dmi_lock.contended++;
+    handoff_stats->dmi_lock.wait_ns.add(dmi_locked_ns - start_ns);
+  }
+  else
+  {
+    dmi_locked_ns = host_time_ns();
+  }
+}
+
+void SimpleCPU::dmi_unlock()
+{
+  if (handoff_stats)
+  {
+    handoff_stats->dmi_lock.hold_ns.add(host_time_ns() - dmi_locked_ns);
+  }
+  pthread_mutex_unlock(dmi_mtx);
+}
+
+const dmi_region *SimpleCPU::dmi_lookup(uint64_t address, uint64_t size,
+                                        Command cmd)
+{
+  const dmi_region *region = dmi_regions.lookup(address);
+
+  /*
+   * Anything not fully granted goes through a transaction, a miss included:
+   * that one asks SystemC for the DMI as well.
+   */
+  if (!region || !region->pointer || !region->contains(address, size))
+  {
+    return NULL;
+  }
+  if ((cmd == READ) ? !region->read_allowed : !region->write_allowed)
+  {
+    return NULL;
+  }
+  return region;
+}
+
+void SimpleCPU::memory_invalidate_direct_mem_ptr(unsigned int index,
+                                                 sc_dt::uint64 start,
+                                                 sc_dt::uint64 end)
+{
+  pthread_mutex_lock(&dmi_invalidate_mtx);
+  dmi_range_merge(dmi_invalidations, start, end);
+  pthread_mutex_unlock(&dmi_invalidate_mtx);
+  __atomic_add_fetch(&dmi_invalidate_epoch, 1, __ATOMIC_RELEASE);
+}
+
+void SimpleCPU::invalidate_registers(uint64_t start, uint64_t end)
+{
+  this->memory_invalidate_direct_mem_ptr(0, start, end);
+}
+
+void SimpleCPU::apply_dmi_invalidations()
+{
+  std::vector<dmi_range> ranges;
+
+  pthread_mutex_lock(&dmi_invalidate_mtx);
+  dmi_applied_epoch = __atomic_load_n(&dmi_invalidate_epoch,
+                                      __ATOMIC_ACQUIRE);
+  ranges.swap(dmi_invalidations);
+  pthread_mutex_unlock(&dmi_invalidate_mtx);
+
+  /* We are on the CPU thread: the model is not using its pointers now. */
+  for (size_t i = 0; i < ranges.size(); i++)
+  {
+    if (shadow)
+    {
+      shadow->invalidate(ranges[i].start, ranges[i].end);
+    }
+    dmi_regions.invalidate(ranges[i].start, ranges[i].end);
+    tlm2c_memory_invalidate_direct_mem_ptr(this->targetSocket,
+                                           ranges[i].start,
+                                           ranges[i].end);
+  }
+}
+
+void SimpleCPU::init_io()
+{
+  io_outstanding = 0;
+  io_announced = 0;
+  io_drained = 0;
+  nb_in_flight = 0;
+  posted_depth = 0;
+  if (posted_writes)
+  {
+    posted_depth = std::min((uint64_t)posted_write_depth,
+                            (uint64_t)io_ring_size);
+  }
+  posted_unsent = 0;
+  posted_write_errors = 0;
+  posted_error_cb = NULL;
+  posted_error_opaque = NULL;
+  io_done.set_policy(sync_policy, wait_spin_count);
+
+  SC_THREAD(do_io);
+
+  SC_METHOD(dummy);
+  sensitive << dummy_evt;
+  dont_initialize();
+}
+
+void SimpleCPU::do_io()
+{
+  io_request *request;
+  io_response response;
+
+  while (true)
+  {
+    wait(io_evt.default_event());
+    /*
+     * Do all the IO for the CPU in the SystemC thread. The request stays in
+     * its ring slot until it is released so the data can be used in place.
+     */
+    while ((request = io_requests.peek()) != NULL)
+    {
+      if (request->dmi_only)
+      {
+        /* From memory_get_direct_mem_ptr(): nothing to transport. */
+        response.address = request->address;
+        response.value = 0;
+        response.data = NULL;
+        response.size = 0;
+        response.cmd = request->cmd;
+        response.status = OK_RESPONSE;
+        response.posted = false;
+        response.host_ns = 0;
+        response.sc_ps = 0;
+        response.done_ps = sc_core::sc_time_stamp().value();
+        response.time_ps = 0;
+        response.nb = false;
+        response.tag = request->tag;
+        response.traced = false;
+        response.has_dmi = true;
+        response.dmi_epoch = __atomic_load_n(&dmi_invalidate_epoch,
+                                             __ATOMIC_ACQUIRE);
+        response.dmi = this->acquire_dmi_region(request->address);
+        io_requests.release();
+        io_drained++;
+        this->finish_io(response);
+        continue;
+      }
+
+      transactionHandle transaction = this->bind_transaction(request);
+      sc_core::sc_time sc_begin = sc_core::sc_time_stamp();
+      uint64_t start_ns = profiler ? host_time_ns() : 0;
+
+      sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+
+      if (request->local_ps > sc_begin.value())
+      {
+        /* The CPU is ahead of SystemC: annotate how far. */
+        delay = sc_core::sc_time::from_value(request->local_ps
+                                             - sc_begin.value());
+      }
+      sc_core::sc_time begin = sc_begin + delay;
+      master_socket.Transact(transaction, delay);
+
+      response.host_ns = profiler ? host_time_ns() - start_ns : 0;
+      response.sc_ps = (sc_core::sc_time_stamp() - sc_begin).value();
+      response.done_ps = sc_core::sc_time_stamp().value();
+      /*
+       * From the local time it started at to the one it ended at: a target
+       * which synchronised already consumed the CPU's lead.
+       */
+      response.time_ps = (sc_core::sc_time_stamp() + delay > begin)
+                       ? (sc_core::sc_time_stamp() + delay - begin).value()
+                       : 0;
+      response.address = request->address;
+      response.value = request->value;
+      response.data = request->data;
+      response.size = request->size;
+      response.posted = request->posted;
+      response.cmd = request->cmd;
+      response.nb = request->nb;
+      response.tag = request->tag;
+      response.traced = request->traced;
+      response.start_ns = request->start_ns;
+      response.has_dmi = request->want_dmi;
+      if (request->want_dmi)
+      {
+        /* The CPU missed in its table: DMI is acquired here, not there. */
+        response.dmi_epoch = __atomic_load_n(&dmi_invalidate_epoch,
+                                             __ATOMIC_ACQUIRE);
+        response.dmi = this->acquire_dmi_region(request->address);
+      }
+      if (transaction->getSResp() == gs::Generic_SRESP_ERR)
+      {
+        response.status = ADDRESS_ERROR_RESPONSE;
+      }
+      else
+      {
+        response.status = OK_RESPONSE;
+      }
+      io_requests.release();
+      io_drained++;
+      this->finish_io(response);
+      quantum_io_count++;
+    }
+
+    if (coordinator && coordinator->at_barrier())
+    {
+      /* The barrier gave up waiting for this IO: run it again. */
+      coordinator->recheck();
+    }
+    else if (!coordinator && this->systemc_has_finished)
+    {
+      /* Notify quantum_notify() as SystemC has finished. */
+      quantum_evt.notify();
+    }
+    else
+    {
+      /*
+       * SystemC won't really sleep here. But it was woken up for nothing by
+       * post_a_transaction.
+       */
+      systemc_sleep();
+    }
+  }
+}
+
+SimpleCPU::transactionHandle SimpleCPU::bind_transaction(io_request *request)
+{
+  io_pool_entry *entry = &io_pool[io_requests.index_of(request)];
+  unsigned char *buffer = request->data ? request->data
+                                        : (unsigned char *)&request->value;
+
+  /*
+   * The pool never adds extensions: the response status and the fields a
+   * request can change are written below instead of a full reset(). The data
+   * is only re-bound when it moved.
+   */
+  entry->transaction->setSResp(gs::Generic_SRESP_NULL);
+  if (entry->buffer != buffer || entry->size != request->size)
+  {
+    entry->transaction->setMData(gs::GSDataType::dtype(buffer,
+                                                       request->size));
+    entry->buffer = buffer;
+    entry->size = request->size;
+  }
+  entry->transaction->setMBurstLength(request->size);
+  entry->transaction->setMAddr(request->address);
+  if (request->cmd == READ)
+  {
+    entry->transaction->setMCmd(gs::Generic_MCMD_RD);
+  }
+  else if (request->cmd == WRITE)
+  {
+    entry->transaction->setMCmd(gs::Generic_MCMD_WR);
+  }
+  return entry->transaction;
+}
+
+void SimpleCPU::finish_io(const io_response& response)
+{
+  bool pushed;
+
+  /*
+   * queue_io() never lets the CPU have more requests in flight than
+   * io_responses can hold so this can't fail.
+   */
+  pushed = io_responses.push(response);
+  assert(pushed);
+  (void)pushed;
+  io_done.post();
+}
+
+void SimpleCPU::wait_for_io_completion(io_response *response)
+{
+  /* Responses come back in order: retire the posted writes queued before. */
+  while (true)
+  {
+    io_done.wait();
+    this->pop_io_response(response);
+    if (!response->posted && !response->nb)
+    {
+      /* The target may have revoked some DMI during the transaction. */
+      this->check_dmi_invalidations();
+      return;
+    }
+    this->retire_response(*response);
+  }
+}
+
+void SimpleCPU::pop_io_response(io_response *response)
+{
+  bool popped;
+
+  /* io_done counts the responses: the pop can't fail. */
+  popped = io_responses.pop(*response);
+  assert(popped);
+  (void)popped;
+  io_outstanding--;
+
+  /*
+   * A grant older than an invalidation might be stale, whatever the range:
+   * dropped, the next access asks again. A target granting a range without the
+   * address is cached like any other.
+   */
+  if (response->has_dmi
+      && response->dmi_epoch == __atomic_load_n(&dmi_invalidate_epoch,
+                                                __ATOMIC_ACQUIRE))
+  {
+    dmi_regions.insert(response->dmi);
+  }
+}
+
+void SimpleCPU::retire_response(const io_response& response)
+{
+  if (response.posted)
+  {
+    this->retire_posted_write(response);
+    return;
+  }
+
+  /* A non-blocking access: kept until the model collects it. */
+  if (response.traced)
+  {
+    this->trace_burst(response.address, response.data, response.size,
+                      response.cmd, response.start_ns);
+  }
+  if (profiler)
+  {
+    profiler->record(response.address, response.size, response.cmd == WRITE,
+                     MMIO_ROUTE_TRANSACTION, response.host_ns,
+                     response.sc_ps);
+  }
+  if (recorder)
+  {
+    /* Stamped with the time it started at, like a blocking burst. */
+    this->record_access(response.cmd, response.address, response.data,
+                        response.size, TRAFFIC_ROUTE_TRANSACTION,
+                        response.status, response.done_ps - response.sc_ps,
+                        0);
+  }
+  nb_in_flight--;
+  nb_completions.push_back(response);
+}
+
+void SimpleCPU::post_a_transaction(const io_request& request,
+                                   io_response *response)
+{
+  /*
+   * As SystemC is not thread safe at all, only SystemC can access SystemC code.
+   * The transaction might come from an other thread so a post mechanism is
+   * implemented to ensure that only SystemC call b_transport for memory access.
+   * The request goes through a lock-free ring drained by do_io() together with
+   * the posted writes queued before it.
+   */
+  this->queue_io(request, io_ring_size);
+  /* Notify the event ASAP. */
+  this->announce_io(posted_unsent + 1);
+  this->wait_for_io_completion(response);
+}
+
+void SimpleCPU::post_a_write(const io_request& request)
+{
+  /*
+   * Posted writes are queued without waking SystemC up: do_io() drains the
+   * whole batch when the queue is full or at the next barrier.
+   */
+  this->queue_io(request, posted_depth);
+  posted_unsent++;
+}
+
+void SimpleCPU::queue_io(const io_request& request, uint32_t depth)
+{
+  bool pushed;
+
+  /*
+   * Every request goes through here. At most depth of them are in flight,
+   * and never more than the rings hold. Flushing announces the posted writes
+   * not sent yet before it waits for them.
+   */
+  if (io_outstanding >= std::min(depth, (uint32_t)io_ring_size))
+  {
+    this->flush_posted_writes();
+  }
+  pushed = io_requests.push(request);
+  assert(pushed);
+  (void)pushed;
+  io_outstanding++;
+}
+
+void SimpleCPU::retire_posted_write(const io_response& response)
+{
+  if (profiler)
+  {
+    /* The CPU didn't wait: account the time SystemC spent on it. */
+    profiler->record(response.address, response.size, true,
+                     MMIO_ROUTE_TRANSACTION, response.host_ns,
+                     response.sc_ps);
+  }
+
+  if (response.status == OK_RESPONSE)
+  {
+    return;
+  }
+
+  __atomic_add_fetch(&posted_write_errors, 1, __ATOMIC_RELAXED);
+  if (posted_error_cb)
+  {
+    posted_error_cb(posted_error_opaque, response.address, response.status);
+  }
+}
+
+void SimpleCPU::io_barrier()
+{
+  if (io_outstanding)
+  {
+    this->flush_posted_writes();
+  }
+  if (fpga_backend)
+  {
+    fpga_backend->flush();
+  }
+}
+
+void SimpleCPU::announce_io(uint32_t count)
+{
+  /* Counted before the notify: the barrier waits for what is announced. */
+  __atomic_add_fetch(&io_announced, count, __ATOMIC_RELEASE);
+  posted_unsent = 0;
+  io_evt.notify();
+  this->wake_up_systemc();
+}
+
+void SimpleCPU::flush_posted_writes()
+{
+  io_response response;
+
+  if (posted_unsent)
+  {
+    this->announce_io(posted_unsent);
+  }
+
+  while (io_outstanding)
+  {
+    io_done.wait();
+    this->pop_io_response(&response);
+    this->retire_response(response);
+  }
+  /* Before the model runs again with its DMI pointers. */
+  this->check_dmi_invalidations();
+}
+
+
+void SimpleCPU::dummy()
+{
+  /* dummy does nothing.. */
+}
+
+void SimpleCPU::init_wait_policy()
+{
+  std::string policy = wait_policy_name;
+
+  if (!sync_semaphore::parse_policy(policy, &sync_policy))
+  {
+    SC_REPORT_ERROR(name(), ("Unknown wait_policy '" + policy + "':\n"
+                             "Use 'block' or 'spin'.").c_str());
+  }
+}
+
+void SimpleCPU::init_systemc_sleep()
+{
+  systemc_wakeup.set_policy(sync_policy, wait_spin_count);
+}
+
+void SimpleCPU::wake_up_systemc()
+{
+  /* Wake up SystemC for IO or at the end of the CPU quantum. */
+  if (coordinator)
+  {
+    coordinator->wake_up_systemc();
+  }
+  else
+  {
+    systemc_wakeup.post();
+  }
+}
+
+void SimpleCPU::systemc_sleep()
+{
+  if (coordinator)
+  {
+    /*
+     * The barrier is where SystemC sleeps with a shared quantum. Between two
+     * barriers SystemC runs freely, only drop the rings already handled.
+     */
+    coordinator->consume_wakeups();
+  }
+  else
+  {
+    /* SystemC is sleeping here until somebody calls wake_up_systemc. */
+    systemc_wakeup.wait();
+  }
+  /* Notify a dummy event just to not increase time for async events. */
+  dummy_evt.notify();
+}
+
+void SimpleCPU::init_cpu_sleep()
+{
+  cpu_wakeup.set_policy(sync_policy, wait_spin_count);
+}
+
+void SimpleCPU::wake_up_cpu()
+{
+  /* Wake up CPU when SystemC has finished it's quantum. */
+  cpu_wakeup.post();
+}
+
+void SimpleCPU::cpu_sleep()
+{
+  /* CPU is sleeping here until SystemC calls wake_up_cpu. */
+  cpu_wakeup.wait();
+}
+
+void SimpleCPU::quantum_notify()
+{
+  /* Wait for the CPU to be initialised, only the first time. */
+  if (!this->cpu_running)
+  {
+    this->wait_for_start();
+  }
+
+  /*
+   * SystemC is going to sleep. CPU thread wakes up SystemC if it posts an IO
+   * or finishes it's quantum.
+   */
+  systemc_has_finished = true;
+  systemc_sleep();
+
+  if (!cpu_has_finished)
+  {
+    return;
+  }
+
+  cpu_has_finished = false;
+  systemc_has_finished = false;
+  this->restore_at_boundary();
+
+  /* Notify for the next quantum. */
+  current_quantum = this->next_quantum();
+  if (this->take_checkpoint() && checkpoint_exit)
+  {
+    /* The CPU is parked: let it go for good before SystemC stops. */
+    cpu_stopped = true;
+    wake_up_cpu();
+    this->stop();
+    return;
+  }
+  quantum_evt.notify(current_quantum, sc_core::SC_NS);
+  quantum_base_ps = sc_core::sc_time_stamp().value();
+  /* Release CPU. */
+  wake_up_cpu();
+}
+
+uint64_t SimpleCPU::next_quantum()
+{
+  uint64_t events = quantum_io_count + quantum_irq_count;
+  uint64_t target = std::max((uint64_t)quantum_target_io, (uint64_t)1);
+  uint64_t low = std::max((uint64_t)quantum_min, (uint64_t)1);
+  uint64_t high = std::max((uint64_t)quantum_max, low);
+  uint64_t next;
+
+  quantum_io_count = 0;
+  quantum_irq_count = 0;
+  if (!quantum_adaptive)
+  {
+    return current_quantum;
+  }
+
+  /*
+   * Scale the quantum so the same IO rate gives target events. Shrink fast
+   * when IO starts and grow slowly so one quiet quantum doesn't undo it.
+   */
+  if (events)
+  {
+    next = (uint64_t)((double)current_quantum * target / events);
+  }
+  else
+  {
+    next = current_quantum * 2;
+  }
+  next = std::max(next, current_quantum / 4);
+  next = std::min(next, current_quantum * 2);
+
+  /* Don't run past a notification the model is waiting for. */
+  next = std::min(next, this->next_notification_ns());
+
+  return std::min(std::max(next, low), high);
+}
+
+gs::cnf::callback_return_type SimpleCPU::quantum_changed(
+                                                gs::gs_param_base& par,
+                                                gs::cnf::callback_type reason)
+{
+  uint64_t value = quantum;
+
+  /* Takes effect at the end of the running quantum. */
+  if (!value)
+  {
+    SC_REPORT_WARNING(this->name(), "quantum can't be 0: ignored.");
+    return gs::cnf::return_nothing;
+  }
+  current_quantum = value;
+  return gs::cnf::return_nothing;
+}
+
+void SimpleCPU::end_of_quantum()
+{
+  uint64_t end_ns = 0;
+  uint64_t local_ps = this->local_time_ps();
+
+  /* First time called at zero for initialisation. */
+  if (!cpu_init)
+  {
+    cpu_thread = pthread_self();
+    if (handoff_stats)
+    {
+      this->quantum_stats_begin();
+    }
+    cpu_init = true;
+    cpu_started.post();
+    if (!restore_pending)
+    {
+      return;
+    }
+    /* Park like at the end of a quantum until the checkpoint is restored. */
+  }
+
+  /* Posted and combined writes must land before the quantum ends. */
+  if (shadow && shadow->is_dirty())
+  {
+    this->flush_shadow();
+  }
+  this->io_barrier();
+
+  if (handoff_stats)
+  {
+    uint64_t io_ns = handoff_stats->io_wait.blocked_ns.sum()
+                   - quantum_io_start_ns;
+
+    end_ns = host_time_ns();
+    handoff_stats->quanta++;
+    handoff_stats->quantum_io_ns.add(io_ns);
+    handoff_stats->quantum_cpu_ns.add(end_ns - quantum_start_ns - io_ns);
+  }
+
+  /* The CPU has finished it's quantum. It just needs to wait for SystemC. */
+  cpu_has_finished = true;
+  if (coordinator)
+  {
+    coordinator->cpu_finished();
+  }
+  else
+  {
+    wake_up_systemc();
+  }
+  cpu_sleep();
+
+  if (cpu_stopped)
+  {
+    /* SystemC won't run again: the model must not go any further. */
+    pthread_exit(NULL);
+  }
+
+  if (handoff_stats)
+  {
+    handoff_stats->quantum_systemc_ns.add(host_time_ns() - end_ns);
+    this->quantum_stats_begin();
+  }
+
+  /* Time spent past the end of the last quantum is carried over. */
+  local_offset_ps = (local_ps > quantum_base_ps) ? local_ps - quantum_base_ps
+                                                 : 0;
+  quantum_expired = false;
+  if (recorder)
+  {
+    this->record_event(TRAFFIC_QUANTUM, 0,
+                       coordinator ? coordinator->get_quantum()
+                                   : current_quantum,
+                       quantum_base_ps);
+  }
+
+  /* SystemC ran meanwhile and may have revoked some DMI. */
+  this->check_dmi_invalidations();
+  this->check_irqs();
+}
+
+uint64_t SimpleCPU::local_time_ns()
+{
+  /* Other threads, SystemC included, see the SystemC time. */
+  if (!decoupled || !cpu_init || !pthread_equal(pthread_self(), cpu_thread))
+  {
+    return this->current_time_ns();
+  }
+  return this->local_time_ps() / 1000 + time_offset_ns;
+}
+
+void SimpleCPU::advance_local_time(uint64_t time_ns)
+{
+  if (decoupled)
+  {
+    this->advance_local_time_ps(time_ns * 1000);
+    /* Accesses only flag it: the model is between two of them here. */
+    if (quantum_expired)
+    {
+      this->end_of_quantum();
+    }
+  }
+}
+
+void SimpleCPU::advance_local_time_ps(uint64_t time_ps)
+{
+  uint64_t quantum_ns = coordinator ? coordinator->get_quantum()
+                                    : current_quantum;
+
+  /* Sync with SystemC only once the whole quantum is consumed. */
+  local_offset_ps += time_ps;
+  if (local_offset_ps >= quantum_ns * 1000)
+  {
+    quantum_expired = true;
+  }
+}
+
+void SimpleCPU::quantum_stats_begin()
+{
+  quantum_start_ns = host_time_ns();
+  quantum_io_start_ns = handoff_stats->io_wait.blocked_ns.sum();
 }
 
-void SimpleCPU::init_io()
+void SimpleCPU::request_checkpoint(const std::string& path)
 {
-  transaction_pending = false;
-  pthread_mutex_init(&io_done_mtx, NULL);
-  pthread_cond_init(&io_done_cond, NULL);
+  checkpoint_path = path;
+}
 
-  SC_THREAD(do_io);
+bool SimpleCPU::take_checkpoint()
+{
+  std::string path;
 
-  SC_METHOD(dummy);
-  sensitive << dummy_evt;
-  dont_initialize();
+  if (!checkpoint_taken && current_time_ns() >= checkpoint_at)
+  {
+    checkpoint_taken = true;
+    checkpoint_path = checkpoint_file;
+  }
+  if (checkpoint_path.empty())
+  {
+    return false;
+  }
+
+  path.swap(checkpoint_path);
+  if (!this->write_checkpoint(path))
+  {
+    /* Tried again at the next boundary. */
+    checkpoint_path.swap(path);
+    return false;
+  }
+  return true;
 }
 
-void SimpleCPU::destroy_io()
+void SimpleCPU::restore_at_boundary()
 {
-  pthread_mutex_destroy(&io_done_mtx);
-  pthread_cond_destroy(&io_done_cond);
+  /*
+   * The CPU is parked in end_of_quantum() and never ran: the DMI memory can
+   * be remapped and the model restored under it.
+   */
+  if (restore_pending)
+  {
+    restore_pending = false;
+    this->restore_checkpoint(restore_file);
+  }
 }
 
-void SimpleCPU::do_io()
+bool SimpleCPU::write_checkpoint(const std::string& path)
 {
-  while (true)
+  checkpoint_writer writer;
+  checkpoint_header state;
+  std::vector<uint8_t> model;
+  std::vector<uint64_t> notifications;
+
+  if (!this->pending_notifications(notifications))
   {
-    wait(io_evt.default_event());
-    /* Do all the IO for the CPU in the SystemC thread. */
-    if (this->transaction_pending)
+    SC_REPORT_WARNING(name(), "Notifications with a cookie are pending: "
+                              "checkpoint postponed.");
+    return false;
+  }
+
+  /* The CPU is parked in end_of_quantum(): its tables are stable. */
+  for (size_t i = 0; i < dmi_regions.count(); i++)
+  {
+    const dmi_region& region = dmi_regions.at(i);
+
+    if (region.pointer)
     {
-      /*
-       * At this time SystemC thread has the io_done_mtx mutex. Just call
-       * b_transport with the pending transaction.
-       */
-      this->transaction_pending = false;
-      master_socket.Transact(this->transaction);
-      this->finish_io();
+      writer.add_region(region.start, region.end, region.pointer);
     }
+  }
 
-    if (this->systemc_has_finished)
+  if (!this->model_checkpoint_save(model))
+  {
+    SC_REPORT_ERROR(name(), "The model failed to save its state.");
+    return false;
+  }
+
+  memset(&state, 0, sizeof(state));
+  state.time_ns = current_time_ns();
+  state.quantum_ns = current_quantum;
+  if (!writer.write(path, state, model, notifications))
+  {
+    SC_REPORT_ERROR(name(), ("Can't write checkpoint '" + path + "'.")
+                    .c_str());
+    return false;
+  }
+  std::cout << name() << ": checkpoint written to " << path << " at "
+            << state.time_ns << " ns" << std::endl;
+  return true;
+}
+
+void SimpleCPU::restore_checkpoint(const std::string& path)
+{
+  checkpoint_image image;
+  const checkpoint_header *header;
+
+  if (!image.open(path))
+  {
+    SC_REPORT_ERROR(name(), ("Can't read checkpoint '" + path + "'.")
+                    .c_str());
+    return;
+  }
+  header = &image.header();
+
+  for (uint32_t i = 0; i < header->region_count; i++)
+  {
+    const checkpoint_region& saved = image.region(i);
+    const dmi_region *region = dmi_regions.lookup(saved.start);
+
+    if (!region)
     {
-      /* Notify quantum_notify() as SystemC has finished. */
-      quantum_evt.notify();
+      /* The CPU is parked: SystemC can fill its table. */
+      dmi_regions.insert(this->acquire_dmi_region(saved.start));
+      region = dmi_regions.lookup(saved.start);
     }
-    else
+    /* Compared bound to bound: end - start + 1 wraps for the whole space. */
+    if (!region || !region->pointer || saved.start < region->start
+        || saved.end > region->end
+        || !image.restore_region(i, region->pointer
+                                    + (saved.start - region->start),
+                                 restore_cow))
     {
-      /*
-       * SystemC won't really sleep here. But it was woken up for nothing by
-       * post_a_transaction.
-       */
-      systemc_sleep();
+      SC_REPORT_ERROR(name(), ("Can't restore the DMI memory of checkpoint '"
+                               + path + "'.").c_str());
+      return;
     }
   }
+
+  if (!this->model_checkpoint_restore(image.model(), header->model_size))
+  {
+    SC_REPORT_ERROR(name(), "The model failed to restore its state.");
+    return;
+  }
+
+  /*
+   * The model carries on from the saved time whatever the SystemC time is now.
+   * The offset wraps when the saved time is the earlier one, the sum doesn't.
+   */
+  time_offset_ns = header->time_ns - sc_core::sc_time_stamp().value() / 1000;
+  /* Used for the next quantum, notified by our caller. */
+  current_quantum = header->quantum_ns;
+  for (uint64_t i = 0; i < header->notification_count; i++)
+  {
+    this->addNotification(image.notifications()[i]);
+  }
 }
 
-void SimpleCPU::finish_io()
+void SimpleCPU::init_recording()
 {
-    if(this->DMIInvalidatePending) {
-        tlm2c_memory_invalidate_direct_mem_ptr(this->targetSocket,
-                                             this->DMIInvalidateStart,
-                                             this->DMIInvalidateEnd);
-        this->DMIInvalidatePending = false;
+  std::string record_path = record_file;
+  std::string replay_path = replay_file;
+
+  recorder = NULL;
+  replay = NULL;
+  if (!replay_path.empty())
+  {
+    if (!record_path.empty())
+    {
+      SC_REPORT_ERROR(name(), "record_file and replay_file can't be used "
+                              "together.");
+      return;
     }
-  pthread_mutex_lock(&io_done_mtx);
-  this->io_completed = true;
-  pthread_mutex_unlock(&this->io_done_mtx);
-  pthread_cond_signal(&io_done_cond);
-}
+    replay = new traffic_reader();
+    if (!replay->open(replay_path))
+    {
+      delete replay;
+      replay = NULL;
+      SC_REPORT_ERROR(name(), ("Can't replay '" + replay_path + "'.").c_str());
+      return;
+    }
+    /* There is no CPU thread to hand the quanta over to. */
+    quantum_evt.cancel();
+    SC_THREAD(replay_driver);
+    return;
+  }
 
-void SimpleCPU::wait_for_io_completion()
-{
-  pthread_mutex_lock(&io_done_mtx);
-  while (!this->io_completed)
+  if (record_path.empty())
+  {
+    return;
+  }
+  recorder = new traffic_recorder();
+  if (!recorder->open(record_path, current_quantum))
   {
-    pthread_cond_wait(&io_done_cond, &io_done_mtx);
+    delete recorder;
+    recorder = NULL;
+    SC_REPORT_ERROR(name(), ("Can't open record_file '" + record_path + "'.")
+                            .c_str());
   }
-  pthread_mutex_unlock(&io_done_mtx);
 }
 
-void SimpleCPU::post_a_transaction()
+bool SimpleCPU::replaying() const
 {
-  /*
-   * As SystemC is not thread safe at all, only SystemC can access SystemC code.
-   * The transaction might come from an other thread so a post mechanism is
-   * implemented to ensure that only SystemC call b_transport for memory access.
-   */
-  this->io_completed = false;
-  this->transaction_pending = true;
-  /* Notify the event ASAP. */
-  io_evt.notify();
-  this->wake_up_systemc();
-  this->wait_for_io_completion();
+  return replay != NULL;
 }
 
-
-void SimpleCPU::dummy()
+void SimpleCPU::record_access(Command cmd, uint64_t address,
+                              const uint8_t *data, uint64_t size,
+                              traffic_record_route route,
+                              ResponseStatus status, uint64_t sc_ps,
+                              uint8_t flags)
 {
-  /* dummy does nothing.. */
+  traffic_record record;
+
+  record.sc_ps = sc_ps;
+  record.address = address;
+  record.value = 0;
+  if (size <= sizeof(record.value))
+  {
+    memcpy(&record.value, data, size);
+  }
+  record.size = size;
+  record.kind = (cmd == WRITE) ? TRAFFIC_WRITE : TRAFFIC_READ;
+  record.route = route;
+  record.status = status;
+  record.flags = flags;
+  recorder->record(record, data);
 }
 
-void SimpleCPU::init_systemc_sleep()
+void SimpleCPU::record_event(traffic_record_kind kind, uint64_t address,
+                             uint64_t value, uint64_t sc_ps)
 {
-  systemc_running = 1;
-  pthread_mutex_init(&sc_sleep_mtx, NULL);
-  pthread_cond_init(&sc_sleep_cond, NULL);
+  traffic_record record;
+
+  memset(&record, 0, sizeof(record));
+  record.sc_ps = sc_ps;
+  record.address = address;
+  record.value = value;
+  record.kind = kind;
+  recorder->record(record, NULL);
 }
 
-void SimpleCPU::wake_up_systemc()
+bool SimpleCPU::replay_irq_seen(const traffic_record& record)
 {
-  /* Wake up SystemC for IO or at the end of the CPU quantum. */
-  pthread_mutex_lock(&sc_sleep_mtx);
-  systemc_running++;
-  pthread_mutex_unlock(&sc_sleep_mtx);
-  pthread_cond_signal(&sc_sleep_cond);
+  std::map<uint32_t, bool>::const_iterator it =
+    replay_irq_levels.find(record.address);
+
+  /* A line never raised is low. */
+  return (it != replay_irq_levels.end() ? it->second : false)
+         == (record.value != 0);
 }
 
-void SimpleCPU::systemc_sleep()
+void SimpleCPU::replay_driver()
 {
-  /* SystemC is sleeping here until somebody calls wake_up_systemc. */
-  pthread_mutex_lock(&sc_sleep_mtx);
-  systemc_running--;
-  while (systemc_running <= 0)
+  traffic_record record;
+  const uint8_t *data;
+  std::vector<uint8_t> buffer;
+  transactionHandle transaction = master_socket.create_transaction();
+  uint64_t quantum_ns = replay->header().quantum_ns;
+  uint64_t accesses = 0;
+  uint64_t skipped = 0;
+  uint64_t quanta = 0;
+  uint64_t read_mismatches = 0;
+  uint64_t status_mismatches = 0;
+  uint64_t irq_timeouts = 0;
+
+  while (replay->next(&record, &data))
   {
-    pthread_cond_wait(&sc_sleep_cond, &sc_sleep_mtx);
+    uint64_t now_ps = sc_core::sc_time_stamp().value();
+    sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+    ResponseStatus status;
+
+    /*
+     * By default only what reached master_socket when it was recorded. With
+     * replay_local the shadow writes are replayed themselves: not their flush.
+     */
+    if (record.kind <= TRAFFIC_WRITE
+        && (replay_local ? (record.flags & TRAFFIC_FLAG_SHADOW_FLUSH) != 0
+                         : record.route != TRAFFIC_ROUTE_TRANSACTION))
+    {
+      skipped++;
+      continue;
+    }
+
+    /* Records are replayed at their time, or late if SystemC is behind. */
+    if (record.sc_ps > now_ps)
+    {
+      wait(sc_core::sc_time::from_value(record.sc_ps - now_ps));
+    }
+
+    if (record.kind == TRAFFIC_QUANTUM)
+    {
+      quantum_ns = record.value;
+      quanta++;
+      continue;
+    }
+
+    if (record.kind == TRAFFIC_IRQ)
+    {
+      /*
+       * The platform raises the IRQ again by itself. The accesses after it
+       * may depend on it: give it up to a quantum to happen.
+       */
+      sc_core::sc_time limit = sc_core::sc_time_stamp()
+                             + sc_core::sc_time((double)quantum_ns,
+                                                sc_core::SC_NS);
+
+      while (!this->replay_irq_seen(record)
+             && sc_core::sc_time_stamp() < limit)
+      {
+        wait(limit - sc_core::sc_time_stamp(), replay_irq_evt);
+      }
+      if (!this->replay_irq_seen(record))
+      {
+        irq_timeouts++;
+      }
+      continue;
+    }
+
+    buffer.assign(std::max((uint64_t)record.size, (uint64_t)8), 0);
+    if (record.kind == TRAFFIC_WRITE)
+    {
+      memcpy(&buffer[0], data ? data : (const uint8_t *)&record.value,
+             record.size);
+    }
+    transaction->setMData(gs::GSDataType::dtype(&buffer[0], record.size));
+    transaction->setMBurstLength(record.size);
+    transaction->setMAddr(record.address);
+    transaction->setMCmd(record.kind == TRAFFIC_READ ? gs::Generic_MCMD_RD
+                                                     : gs::Generic_MCMD_WR);
+    /* The transaction is reused: clear the previous response. */
+    transaction->setSResp(gs::Generic_SRESP_NULL);
+    master_socket.Transact(transaction, delay);
+
+    status = (transaction->getSResp() == gs::Generic_SRESP_ERR)
+             ? ADDRESS_ERROR_RESPONSE : OK_RESPONSE;
+    if (!(record.flags & TRAFFIC_FLAG_STATUS_UNKNOWN)
+        && (uint8_t)status != record.status)
+    {
+      status_mismatches++;
+    }
+    /* Only the data of accesses up to 8 bytes is recorded. */
+    if (record.kind == TRAFFIC_READ && record.size <= sizeof(record.value)
+        && memcmp(&buffer[0], &record.value, record.size))
+    {
+      read_mismatches++;
+    }
+    accesses++;
   }
-  pthread_mutex_unlock(&sc_sleep_mtx);
-  /* Notify a dummy event just to not increase time for async events. */
-  dummy_evt.notify();
+
+  master_socket.release_transaction(transaction);
+  std::cout << name() << ": replayed " << accesses << " accesses ("
+            << skipped << " skipped) over " << quanta << " quanta, "
+            << read_mismatches << " read mismatches, " << status_mismatches
+            << " status mismatches, " << irq_timeouts << " IRQ timeouts."
+            << std::endl;
+  stop_evt.notify();
 }
 
-void SimpleCPU::destroy_systemc_sleep()
+void SimpleCPU::init_shared_quantum()
 {
-  pthread_mutex_destroy(&sc_sleep_mtx);
-  pthread_cond_destroy(&sc_sleep_cond);
+  coordinator = NULL;
+  /* A replay doesn't hold the other CPUs back. */
+  if (!shared_quantum || replay)
+  {
+    return;
+  }
+
+  coordinator = quantum_coordinator::join(shared_quantum_group, this,
+                                         current_quantum, sync_policy,
+                                         wait_spin_count);
+  /* The coordinator drives the quantum, quantum_notify() never runs. */
+  quantum_evt.cancel();
+
+  if (coordinator->get_quantum() != current_quantum)
+  {
+    SC_REPORT_WARNING(this->name(), "quantum differs from the shared quantum: "
+                                    "using the shared one.");
+  }
+  if (quantum_adaptive || !((std::string)checkpoint_file).empty())
+  {
+    SC_REPORT_WARNING(this->name(), "quantum_adaptive and checkpoint_file "
+                                    "are ignored with shared_quantum.");
+  }
 }
 
-void SimpleCPU::init_cpu_sleep()
+void SimpleCPU::init_shadow()
 {
-  cpu_running = 1;
-  pthread_mutex_init(&cpu_sleep_mtx, NULL);
-  pthread_cond_init(&cpu_sleep_cond, NULL);
+  std::string ranges = shadow_ranges;
+  size_t pos = 0;
+  char *end;
+
+  shadow = NULL;
+  if (ranges.empty())
+  {
+    return;
+  }
+  shadow = new shadow_registers();
+
+  /* "start:end:mode,start:end:mode", both ends included. */
+  while (pos < ranges.size())
+  {
+    const char *range = ranges.c_str() + pos;
+    uint64_t start = strtoull(range, &end, 0);
+    uint64_t last;
+    size_t mode_end;
+    std::string mode;
+    bool added;
+
+    if (*end != ':')
+    {
+      break;
+    }
+    last = strtoull(end + 1, &end, 0);
+    if (*end != ':' || last < start)
+    {
+      break;
+    }
+    pos = end + 1 - ranges.c_str();
+    mode_end = std::min(ranges.find(',', pos), ranges.size());
+    mode = ranges.substr(pos, mode_end - pos);
+    if (mode == "read")
+    {
+      added = shadow->add_range(start, last, SHADOW_READ);
+    }
+    else if (mode == "write-through")
+    {
+      added = shadow->add_range(start, last, SHADOW_WRITE_THROUGH);
+    }
+    else if (mode == "write-back")
+    {
+      added = shadow->add_range(start, last, SHADOW_WRITE_BACK);
+    }
+    else
+    {
+      break;
+    }
+    if (!added)
+    {
+      SC_REPORT_ERROR(name(), ("Overlapping or too large shadow_registers '"
+                               + ranges + "'.").c_str());
+      return;
+    }
+    pos = mode_end + (mode_end < ranges.size());
+  }
+
+  if (pos < ranges.size())
+  {
+    SC_REPORT_ERROR(name(), ("Malformed shadow_registers '" + ranges + "':\n"
+                             "Use 'start:end:mode,start:end:mode' with mode "
+                             "'read', 'write-through' or 'write-back'.")
+                             .c_str());
+  }
 }
 
-void SimpleCPU::wake_up_cpu()
+void SimpleCPU::flush_shadow()
 {
-  /* Wake up CPU when SystemC has finished it's quantum. */
-  pthread_mutex_lock(&cpu_sleep_mtx);
-  cpu_running++;
-  pthread_mutex_unlock(&cpu_sleep_mtx);
-  pthread_cond_signal(&cpu_sleep_cond);
+  std::vector<shadow_write> writes;
+  io_request request;
+  io_response response;
+
+  shadow->take_dirty(writes);
+  for (size_t i = 0; i < writes.size(); i++)
+  {
+    request.address = writes[i].address;
+    request.value = 0;
+    memcpy(&request.value, writes[i].data, writes[i].size);
+    request.data = NULL;
+    request.size = writes[i].size;
+    request.cmd = WRITE;
+    request.posted = posted_depth != 0;
+    request.nb = false;
+    request.want_dmi = false;
+    request.dmi_only = false;
+    request.traced = false;
+    request.local_ps = decoupled ? this->local_time_ps() : 0;
+
+    if (recorder)
+    {
+      this->record_access(WRITE, request.address,
+                          (uint8_t *)&request.value, request.size,
+                          TRAFFIC_ROUTE_TRANSACTION, OK_RESPONSE,
+                          this->access_time_ps(),
+                          TRAFFIC_FLAG_POSTED | TRAFFIC_FLAG_STATUS_UNKNOWN
+                          | TRAFFIC_FLAG_SHADOW_FLUSH);
+    }
+
+    /* The model didn't wait for them: errors are reported as posted ones. */
+    if (request.posted)
+    {
+      this->post_a_write(request);
+      continue;
+    }
+    this->post_a_transaction(request, &response);
+    this->retire_posted_write(response);
+  }
 }
 
-void SimpleCPU::cpu_sleep()
+void SimpleCPU::shadow_barrier(Command cmd, uint64_t address, size_t len)
 {
-  /* CPU is sleeping here until SystemC calls wake_up_cpu. */
-  pthread_mutex_lock(&cpu_sleep_mtx);
-  cpu_running--;
-  while (cpu_running <= 0)
+  /* Accesses bypassing the shadow copy see the writes held back. */
+  if (!shadow)
+  {
+    return;
+  }
+  if (shadow->is_dirty())
   {
-    pthread_cond_wait(&cpu_sleep_cond, &cpu_sleep_mtx);
+    this->flush_shadow();
+  }
+  if (cmd == WRITE)
+  {
+    shadow->invalidate(address, address + len - 1);
   }
-  pthread_mutex_unlock(&cpu_sleep_mtx);
 }
 
-void SimpleCPU::destroy_cpu_sleep()
+void SimpleCPU::wait_for_start()
 {
-  pthread_mutex_destroy(&cpu_sleep_mtx);
-  pthread_cond_destroy(&cpu_sleep_cond);
+  cpu_started.wait();
+  this->cpu_running = true;
 }
 
-void SimpleCPU::quantum_notify()
+bool SimpleCPU::io_pending()
 {
-  /* Wait for the CPU to be initialised. */
-  while (!this->cpu_init);
-
   /*
-   * SystemC is going to sleep. CPU thread wakes up SystemC if it posts an IO
-   * or finishes it's quantum.
+   * Posted writes still queued without a notify don't count: do_io() won't
+   * run for them and wouldn't recheck() the barrier. Both count prefixes of
+   * the ring, do_io() may have drained past the last announce.
    */
-  systemc_has_finished = true;
-  systemc_sleep();
-
-  if (!cpu_has_finished)
-  {
-    return;
-  }
+  return __atomic_load_n(&io_announced, __ATOMIC_ACQUIRE) > io_drained;
+}
 
+void SimpleCPU::start_quantum()
+{
+  this->restore_at_boundary();
   cpu_has_finished = false;
-  systemc_has_finished = false;
-
-  /* Notify for the next quantum. */
-  quantum_evt.notify(quantum, sc_core::SC_NS);
-  /* Release CPU. */
+  quantum_base_ps = sc_core::sc_time_stamp().value();
   wake_up_cpu();
 }
 
-void SimpleCPU::end_of_quantum()
+void SimpleCPU::init_irq()
 {
-  /* First time called at zero for initialisation. */
-  if (!cpu_init)
+  std::string lines = irq_immediate;
+  size_t pos = 0;
+  char *end;
+
+  irq_front = NULL;
+  if (!irq_coalesce)
   {
-    cpu_init = true;
     return;
   }
+  irq_front = new irq_coalescer();
 
-  /* The CPU has finished it's quantum. It just needs to wait for SystemC. */
-  cpu_has_finished = true;
-  wake_up_systemc();
-  cpu_sleep();
+  /* "line,first-last", both ends included. */
+  while (pos < lines.size())
+  {
+    const char *range = lines.c_str() + pos;
+    uint64_t first = strtoull(range, &end, 0);
+    uint64_t last = first;
+
+    if (end == range)
+    {
+      break;
+    }
+    if (*end == '-')
+    {
+      last = strtoull(end + 1, &end, 0);
+    }
+    if ((*end != ',' && *end != '\0') || last < first)
+    {
+      break;
+    }
+    last = std::min(last, (uint64_t)irq_coalescer::line_count - 1);
+    for (uint64_t line = first; line <= last; line++)
+    {
+      irq_front->set_immediate(line);
+    }
+    pos = end - lines.c_str() + (*end == ',');
+  }
+
+  if (pos < lines.size())
+  {
+    SC_REPORT_ERROR(name(), ("Malformed irq_immediate '" + lines + "':\n"
+                             "Use 'line,first-last'.").c_str());
+  }
+}
+
+void SimpleCPU::deliver_irq(void *opaque, uint32_t line, bool level)
+{
+  SimpleCPU *_this = (SimpleCPU *)opaque;
+
+  payload_set_address(_this->irq_batch_payload, line);
+  payload_set_value(_this->irq_batch_payload, level);
+  b_transport(_this->initiatorSocket, (Payload *)_this->irq_batch_payload);
 }
 
 void SimpleCPU::stop_request()
 {
   stop_evt.notify();
-  wake_up_systemc();
+  if (coordinator)
+  {
+    coordinator->interrupt();
+  }
+  else
+  {
+    wake_up_systemc();
+  }
 }
 
 void SimpleCPU::stop()
 {
+  this->report_profile();
+  this->report_sync_stats();
+  if (recorder && !recorder->close())
+  {
+    std::ostringstream msg;
+
+    msg << recorder->get_write_errors() << " write error(s) on record_file '"
+        << (std::string)record_file << "': the recording is incomplete.";
+    SC_REPORT_WARNING(name(), msg.str().c_str());
+  }
   sc_core::sc_stop();
 }
 
@@ -568,75 +2603,39 @@ void SimpleCPU::irq_b_transport(unsigned int port, irqPayload& payload,
 {
   IRQ_ext_data *data = (IRQ_ext_data *)(payload.get_data_ptr());
 
-  static GenericPayload *p = payload_create();
-  payload_set_address(p, data->irq_line);
-  payload_set_value(p, data->value);
-  payload_set_command(p, WRITE);
-  b_transport(this->initiatorSocket, (Payload *)p);
-}
-
-#if AWS_FPGA_PRESENT
-
-/* write data to FPGA RAM */
-bool SimpleCPU::data_write(uint64_t addr, uint8_t *p_data, int len)
-{
-    bool ret  = true;
-    int index = 0;
-    bool poke_ret = false;
-
-    if (len >= 4 && (len%4 != 0 || ((addr&0x3) != 0)))
-        SC_REPORT_ERROR(name(), "ERROR: data_write only support 4 byte alignment read, when len is more than 4!\n");
-
-    //Process the 4 byte alignment data.
-    while (len >= 4)
-    {
-        poke_ret = fpga_pci_poke(pci_bar_handle, (addr+index), *(reinterpret_cast<uint32_t *>(&(p_data[index]))));
-        ret   = ret & poke_ret;
-        len   = len - 4;
-        index = index + 4;
-    }
-
-    //Process the 1 byte data, need aws-fpga sdk v1.4 to support 8 bit read and write.
-    if (len == 1)
-    {
-        poke_ret = fpga_pci_poke8(pci_bar_handle, (addr+index), *(reinterpret_cast<uint8_t *>(&(p_data[index]))));
-        ret   = ret & poke_ret;
-    }
-
-    return ret;
-}
-
-/* read data from FPGA RAM */
-bool SimpleCPU::data_read(uint64_t addr, uint8_t *p_data, int len)
-{
-    bool ret  = true;
-    int index = 0;
-    bool peek_ret = false;
-
-    if (len >= 4 && (len%4 != 0 || ((addr&0x3) != 0)))
-        SC_REPORT_ERROR(name(), "ERROR: data_read only support 4 byte alignment read, when len is more than 4!\n");
-    
-    while (len >= 4)
-    {
-        peek_ret = fpga_pci_peek(pci_bar_handle, (addr+index)&0xfffffffc, reinterpret_cast<uint32_t *>(&(p_data[index])));
-        ret   = ret & peek_ret;
-        len   = len - 4;
-        index = index + 4;
-    }
-
-    if (len == 1)
-    {
-        peek_ret = fpga_pci_peek8(pci_bar_handle, (addr+index), reinterpret_cast<uint8_t *>(&(p_data[index])));
-        ret   = ret & peek_ret;
-    }
+  quantum_irq_count++;
+  if (recorder)
+  {
+    this->record_event(TRAFFIC_IRQ, data->irq_line, data->value,
+                       sc_core::sc_time_stamp().value());
+  }
+  if (replay)
+  {
+    /* No model behind: the replay driver only waits for the edges. */
+    replay_irq_levels[data->irq_line] = data->value;
+    replay_irq_evt.notify();
+    return;
+  }
+  if (irq_front && !irq_front->is_immediate(data->irq_line))
+  {
+    /* The CPU thread delivers it at its next safe point. */
+    irq_front->set_level(data->irq_line, data->value);
+    return;
+  }
 
-    return ret;
+  payload_set_address(this->irq_payload, data->irq_line);
+  payload_set_value(this->irq_payload, data->value);
+  b_transport(this->initiatorSocket, (Payload *)this->irq_payload);
 }
 
+#if AWS_FPGA_PRESENT
 /* Get the PCI handle, which make the SimpleCPU read and write the FPGA RAM directly */
 bool SimpleCPU::set_pci_bar_handle(pci_bar_handle_t pci_bar_handle_in)
 {
-  pci_bar_handle = pci_bar_handle_in;
+  delete fpga_backend;
+  fpga_backend = new aws_register_backend(pci_bar_handle_in,
+                                          fpga_write_combine);
+  init_write_combine(fpga_backend);
   return true;
 }
 #endif
@@ -0,0 +1,212 @@
+/*
+ * sync_semaphore.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/sync_semaphore.h"
+#include "SimpleCPU/host_time.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+sync_semaphore::sync_semaphore(int initial):
+  count(initial),
+  waiters(0),
+  policy(WAIT_BLOCK),
+  spin_count(0),
+  stats(NULL)
+{
+#ifndef __linux__
+  pthread_mutex_init(&mtx, NULL);
+  pthread_cond_init(&cond, NULL);
+#endif
+}
+
+sync_semaphore::~sync_semaphore()
+{
+#ifndef __linux__
+  pthread_mutex_destroy(&mtx);
+  pthread_cond_destroy(&cond);
+#endif
+}
+
+void sync_semaphore::set_policy(wait_policy policy, uint32_t spin_count)
+{
+  this->policy = policy;
+  this->spin_count = spin_count;
+}
+
+void sync_semaphore::set_stats(wait_point_stats *stats)
+{
+  this->stats = stats;
+}
+
+bool sync_semaphore::parse_policy(const std::string& name,
+                                  wait_policy *policy)
+{
+  if (name == "block")
+  {
+    *policy = WAIT_BLOCK;
+  }
+  else if (name == "spin")
+  {
+    *policy = WAIT_SPIN;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool sync_semaphore::try_wait()
+{
+  int value = __atomic_load_n(&count, __ATOMIC_SEQ_CST);
+
+  while (value > 0)
+  {
+    if (__atomic_compare_exchange_n(&count, &value, value - 1, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void sync_semaphore::post()
+{
+  __atomic_add_fetch(&count, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&waiters, __ATOMIC_SEQ_CST))
+  {
+    wake();
+  }
+}
+
+void sync_semaphore::wait()
+{
+  uint64_t start_ns;
+  bool woken;
+
+  if (stats)
+  {
+    stats->waits++;
+    if (try_wait())
+    {
+      stats->immediate++;
+      return;
+    }
+  }
+  /* Only read the clock when we are going to wait. */
+  start_ns = stats ? host_time_ns() : 0;
+
+  if (policy == WAIT_SPIN)
+  {
+    for (uint32_t i = 0; i < spin_count; i++)
+    {
+      if (try_wait())
+      {
+        if (stats)
+        {
+          stats->spun++;
+          stats->blocked_ns.add(host_time_ns() - start_ns);
+        }
+        return;
+      }
+      sync_cpu_relax();
+    }
+  }
+
+  woken = try_wait();
+  while (!woken)
+  {
+    /*
+     * Register as a waiter before sleeping: post() only wakes somebody up when
+     * there is a waiter, and the futex refuses to sleep if count moved.
+     */
+    __atomic_add_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+    sleep(0);
+    __atomic_sub_fetch(&waiters, 1, __ATOMIC_SEQ_CST);
+    woken = try_wait();
+    if (stats)
+    {
+      stats->wakeups++;
+      stats->spurious += !woken;
+    }
+  }
+
+  if (stats)
+  {
+    stats->blocked_ns.add(host_time_ns() - start_ns);
+  }
+}
+
+#ifdef __linux__
+void sync_semaphore::sleep(int value)
+{
+  syscall(SYS_futex, &count, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+void sync_semaphore::wake()
+{
+  syscall(SYS_futex, &count, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
+void sync_semaphore::sleep(int value)
+{
+  pthread_mutex_lock(&mtx);
+  while (__atomic_load_n(&count, __ATOMIC_SEQ_CST) == value)
+  {
+    pthread_cond_wait(&cond, &mtx);
+  }
+  pthread_mutex_unlock(&mtx);
+}
+
+void sync_semaphore::wake()
+{
+  pthread_mutex_lock(&mtx);
+  pthread_mutex_unlock(&mtx);
+  pthread_cond_signal(&cond);
+}
+#endif
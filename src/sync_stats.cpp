@@ -0,0 +1,105 @@
+/*
+ * sync_stats.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+#include "SimpleCPU/sync_stats.h"
+
+static void print_histogram(std::ostream& os, const char *what,
+                            const log2_histogram& h)
+{
+  os << "  " << what << " ns(total/mean/p50/p99/max)=" << h.sum() << "/"
+     << h.mean() << "/" << h.percentile(50) << "/" << h.percentile(99) << "/"
+     << h.max() << std::endl;
+}
+
+wait_point_stats::wait_point_stats():
+  waits(0),
+  immediate(0),
+  spun(0),
+  wakeups(0),
+  spurious(0)
+{
+
+}
+
+void wait_point_stats::print(std::ostream& os, const char *name) const
+{
+  os << name << ": waits=" << waits << " immediate=" << immediate
+     << " spun=" << spun << " wakeups=" << wakeups
+     << " spurious=" << spurious << std::endl;
+  print_histogram(os, "blocked", blocked_ns);
+}
+
+lock_stats::lock_stats():
+  acquisitions(0),
+  contended(0)
+{
+
+}
+
+void lock_stats::print(std::ostream& os, const char *name) const
+{
+  os << name << ": acquisitions=" << acquisitions
+     << " contended=" << contended << std::endl;
+  print_histogram(os, "wait", wait_ns);
+  print_histogram(os, "hold", hold_ns);
+}
+
+sync_stats::sync_stats():
+  quanta(0)
+{
+
+}
+
+void sync_stats::print(std::ostream& os) const
+{
+  os << "Synchronisation statistics:" << std::endl;
+  cpu_sleep.print(os, "cpu_sleep");
+  systemc_sleep.print(os, "systemc_sleep");
+  io_wait.print(os, "io_wait");
+  cpu_init.print(os, "cpu_init");
+  dmi_lock.print(os, "dmi_lock");
+  os << "quanta: " << quanta << std::endl;
+  print_histogram(os, "cpu", quantum_cpu_ns);
+  print_histogram(os, "io", quantum_io_ns);
+  print_histogram(os, "systemc", quantum_systemc_ns);
+}
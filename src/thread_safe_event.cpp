@@ -42,24 +42,103 @@
 
 #include "SimpleCPU/thread_safe_event.h"
 
-thread_safe_event::thread_safe_event(const char* name)
+thread_safe_event::thread_safe_event(const char* name):
+  m_update_requested(false),
+  m_overflowing(false),
+  m_overflows(0),
+  m_callback(NULL),
+  m_callback_opaque(NULL)
 {
+  pthread_mutex_init(&m_overflow_mutex, NULL);
+}
 
+thread_safe_event::~thread_safe_event()
+{
+  pthread_mutex_destroy(&m_overflow_mutex);
 }
 
 void thread_safe_event::notify(sc_core::sc_time delay)
 {
-  m_delay = delay;
-  async_request_update();
+  this->notify(delay, NULL);
+}
+
+void thread_safe_event::notify(sc_core::sc_time delay, void *payload)
+{
+  notification n;
+
+  n.delay = delay.value();
+  n.payload = payload;
+  if (__atomic_load_n(&m_overflowing, __ATOMIC_SEQ_CST) || !m_queue.push(n))
+  {
+    pthread_mutex_lock(&m_overflow_mutex);
+    m_overflow.push_back(n);
+    __atomic_store_n(&m_overflowing, true, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&m_overflow_mutex);
+    __atomic_add_fetch(&m_overflows, 1, __ATOMIC_RELAXED);
+  }
+
+  /* One update for the whole batch: the mutex in there is the costly part. */
+  if (!__atomic_exchange_n(&m_update_requested, true, __ATOMIC_SEQ_CST))
+  {
+    async_request_update();
+  }
 }
 
 const sc_core::sc_event& thread_safe_event::default_event() const
 {
-  return m_event;
+  return m_events.default_event();
 }
 
-void thread_safe_event::update(void)
+void thread_safe_event::set_drain_callback(drain_callback callback,
+                                           void *opaque)
+{
+  m_callback = callback;
+  m_callback_opaque = opaque;
+}
+
+uint64_t thread_safe_event::get_overflows() const
 {
-  m_event.notify(m_delay);
+  return __atomic_load_n(&m_overflows, __ATOMIC_RELAXED);
 }
 
+void thread_safe_event::drain(const notification &n)
+{
+  sc_core::sc_time delay = sc_core::sc_time::from_value(n.delay);
+
+  m_events.notify(delay);
+  if (n.payload && m_callback)
+  {
+    m_callback(m_callback_opaque, delay, n.payload);
+  }
+}
+
+void thread_safe_event::update(void)
+{
+  std::deque<notification> overflow;
+  notification n;
+
+  /* Cleared first: a notify() racing with the drain asks for a new update. */
+  __atomic_store_n(&m_update_requested, false, __ATOMIC_SEQ_CST);
+
+  while (m_queue.pop(n))
+  {
+    this->drain(n);
+  }
+
+  /*
+   * After the queue: whatever overflowed was notified after the queued entries
+   * of the same thread.
+   */
+  if (__atomic_load_n(&m_overflowing, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&m_overflow_mutex);
+    overflow.swap(m_overflow);
+    __atomic_store_n(&m_overflowing, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&m_overflow_mutex);
+    for (std::deque<notification>::const_iterator it = overflow.begin();
+         it != overflow.end(); it++)
+    {
+      this->drain(*it);
+    }
+  }
+}
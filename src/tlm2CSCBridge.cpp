@@ -43,8 +43,16 @@
 #include "SimpleCPU/tlm2CSCBridge.h"
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
+#include <cstdio>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
 
 static void request_notify(void *handler, uint64_t time_ns);
 static uint64_t get_time_ns(void *handler);
@@ -54,13 +62,36 @@ static uint64_t get_uint_param(void *handler, const char *name);
 static int64_t get_int_param(void *handler, const char *name);
 static void get_string_param(void *handler, const char *name, char **param);
 static void signal_end_of_quantum(void *handler);
+static void register_checkpoint(void *handler, void *opaque,
+                                tlm2c_checkpoint_save_fn save,
+                                tlm2c_checkpoint_restore_fn restore);
+static void request_notify_cookie(void *handler, uint64_t time_ns,
+                                  void *cookie);
+static void register_notify_handler(void *handler, void *opaque,
+                                    tlm2c_notify_fired_fn fired);
+static const char *get_param_string(void *handler, const char *name);
+static size_t get_params(void *handler, const char *prefix,
+                         const char **names, const char **values, size_t max);
+static void advance_time(void *handler, uint64_t time_ns);
 
 std::vector<std::string> TLM2CSCBridge::libraryNames;
 std::vector<int> TLM2CSCBridge::libraryOccurence;
 
 TLM2CSCBridge::TLM2CSCBridge(sc_core::sc_module_name name):
   sc_core::sc_module(name),
-  libraryName("library", "no")
+  time_offset_ns(0),
+  tlm2c_model(NULL),
+  notification_at_ns(0),
+  notify_opaque(NULL),
+  notify_fired(NULL),
+  checkpoint_opaque(NULL),
+  checkpoint_save(NULL),
+  checkpoint_restore(NULL),
+  removeLibrary(false),
+  libraryHandle(NULL),
+  libraryFd(-1),
+  libraryName("library", "no"),
+  libraryLoader("library_loader", "auto")
 {
   this->environment.get_time_ns = get_time_ns;
   this->environment.request_stop = request_stop;
@@ -72,17 +103,42 @@ TLM2CSCBridge::TLM2CSCBridge(sc_core::sc_module_name name):
   this->environment.end_of_quantum = signal_end_of_quantum;
   this->environment.handler = this;
 
+  memset(&this->extensions, 0, sizeof(this->extensions));
+  this->extensions.size = sizeof(this->extensions);
+  this->extensions.handler = this;
+  this->extensions.register_checkpoint = ::register_checkpoint;
+  this->extensions.request_notify_cookie = ::request_notify_cookie;
+  this->extensions.register_notify_handler = ::register_notify_handler;
+  this->extensions.get_param_string = ::get_param_string;
+  this->extensions.get_params = ::get_params;
+  this->extensions.advance_time = ::advance_time;
+
+  pthread_mutex_init(&timer_mtx, NULL);
+
+  /* The model has always been notified once when the simulation starts. */
+  notify_timer start = {0, NULL, false};
+  timers.push(start);
+
   SC_METHOD(notification);
   sensitive << tlm2c_method;
+
+  SC_METHOD(schedule_timers);
+  sensitive << timer_request_evt;
+  dont_initialize();
 }
 
 TLM2CSCBridge::~TLM2CSCBridge()
 {
   this->cleanLibrary();
+  pthread_mutex_destroy(&timer_mtx);
 }
 
 void TLM2CSCBridge::before_end_of_elaboration()
 {
+  if (this->replaying())
+  {
+    return;
+  }
   this->loadLibrary();
   this->init();
 }
@@ -95,14 +151,159 @@ void TLM2CSCBridge::end_of_elaboration()
 void TLM2CSCBridge::notification()
 {
   /*
-   * This is called for every notified method in tlm2c.
+   * Fire every timer due now: one model_notify() for all the plain requests
+   * and one call of the handler for all the cookies.
    */
-  model_notify(this->tlm2c_model);
+  uint64_t now_ns = sc_core::sc_time_stamp().value() / 1000;
+  bool notify = false;
+
+  fired_cookies.clear();
+  while (!timers.empty() && timers.top().at_ns <= now_ns)
+  {
+    if (timers.top().has_cookie && notify_fired)
+    {
+      fired_cookies.push_back(timers.top().cookie);
+    }
+    else
+    {
+      notify = true;
+    }
+    timers.pop();
+  }
+
+  notification_at_ns = timers.empty() ? ~(uint64_t)0 : timers.top().at_ns;
+  if (!timers.empty())
+  {
+    tlm2c_method.notify(sc_core::sc_time((double)(notification_at_ns - now_ns),
+                                         sc_core::SC_NS));
+  }
+
+  if (!fired_cookies.empty())
+  {
+    notify_fired(notify_opaque, &fired_cookies[0], fired_cookies.size());
+  }
+  if (notify && this->tlm2c_model)
+  {
+    model_notify(this->tlm2c_model);
+  }
+}
+
+bool TLM2CSCBridge::replaying() const
+{
+  return false;
 }
 
 void TLM2CSCBridge::addNotification(uint64_t time_ns)
 {
-  tlm2c_method.notify(sc_core::sc_time((double)(time_ns), sc_core::SC_NS));
+  this->add_timer(time_ns, NULL, false);
+}
+
+void TLM2CSCBridge::addNotification(uint64_t time_ns, void *cookie)
+{
+  this->add_timer(time_ns, cookie, true);
+}
+
+void TLM2CSCBridge::add_timer(uint64_t time_ns, void *cookie, bool has_cookie)
+{
+  /*
+   * The model asks from its own thread: the request is only moved to the heap
+   * by schedule_timers(), in the SystemC thread. The delay is relative to the
+   * time the model sees, which is ahead of SystemC when decoupled: the deadline
+   * is made absolute here and brought back to the SystemC time base.
+   */
+  notify_timer timer = {this->local_time_ns() - time_offset_ns + time_ns,
+                        cookie, has_cookie};
+  bool first;
+
+  pthread_mutex_lock(&timer_mtx);
+  first = timer_requests.empty();
+  timer_requests.push_back(timer);
+  pthread_mutex_unlock(&timer_mtx);
+
+  if (first)
+  {
+    timer_request_evt.notify();
+  }
+}
+
+void TLM2CSCBridge::schedule_timers()
+{
+  uint64_t now_ns = sc_core::sc_time_stamp().value() / 1000;
+  std::vector<notify_timer> requests;
+
+  pthread_mutex_lock(&timer_mtx);
+  requests.swap(timer_requests);
+  pthread_mutex_unlock(&timer_mtx);
+
+  for (size_t i = 0; i < requests.size(); i++)
+  {
+    timers.push(requests[i]);
+  }
+
+  if (!timers.empty() && timers.top().at_ns < notification_at_ns)
+  {
+    /*
+     * The event keeps the earliest notification anyway. SystemC may already
+     * have passed a deadline requested just before it moved on.
+     */
+    notification_at_ns = timers.top().at_ns;
+    tlm2c_method.notify(sc_core::sc_time(
+                          (double)(notification_at_ns > now_ns
+                                   ? notification_at_ns - now_ns : 0),
+                          sc_core::SC_NS));
+  }
+}
+
+void TLM2CSCBridge::register_notify_handler(void *opaque,
+                                            tlm2c_notify_fired_fn fired)
+{
+  notify_opaque = opaque;
+  notify_fired = fired;
+}
+
+uint64_t TLM2CSCBridge::next_notification_ns() const
+{
+  uint64_t now_ns = sc_core::sc_time_stamp().value() / 1000;
+
+  if (notification_at_ns == ~(uint64_t)0)
+  {
+    return ~(uint64_t)0;
+  }
+  return (notification_at_ns > now_ns) ? notification_at_ns - now_ns : 0;
+}
+
+bool TLM2CSCBridge::pending_notifications(std::vector<uint64_t>& delays)
+{
+  std::priority_queue<notify_timer, std::vector<notify_timer>,
+                      notify_timer_later> pending = timers;
+  uint64_t now_ns = sc_core::sc_time_stamp().value() / 1000;
+  bool saved = true;
+
+  /* Without a handler a cookie timer is a plain notification. */
+  delays.clear();
+  pthread_mutex_lock(&timer_mtx);
+  for (size_t i = 0; i < timer_requests.size(); i++)
+  {
+    if (timer_requests[i].has_cookie && notify_fired)
+    {
+      saved = false;
+    }
+    delays.push_back(timer_requests[i].at_ns > now_ns
+                     ? timer_requests[i].at_ns - now_ns : 0);
+  }
+  pthread_mutex_unlock(&timer_mtx);
+
+  while (!pending.empty())
+  {
+    if (pending.top().has_cookie && notify_fired)
+    {
+      saved = false;
+    }
+    delays.push_back(pending.top().at_ns > now_ns
+                     ? pending.top().at_ns - now_ns : 0);
+    pending.pop();
+  }
+  return saved;
 }
 
 void request_notify(void *handler, uint64_t time_ns)
@@ -111,17 +312,102 @@ void request_notify(void *handler, uint64_t time_ns)
   _this->addNotification(time_ns);
 }
 
+void request_notify_cookie(void *handler, uint64_t time_ns, void *cookie)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  _this->addNotification(time_ns, cookie);
+}
+
+void register_notify_handler(void *handler, void *opaque,
+                             tlm2c_notify_fired_fn fired)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  _this->register_notify_handler(opaque, fired);
+}
+
+uint64_t TLM2CSCBridge::current_time_ns() const
+{
+  return sc_core::sc_time_stamp().value() / 1000 + time_offset_ns;
+}
+
+uint64_t TLM2CSCBridge::local_time_ns()
+{
+  return this->current_time_ns();
+}
+
+void TLM2CSCBridge::advance_local_time(uint64_t time_ns)
+{
+  /* Time only moves with SystemC. */
+}
+
 uint64_t get_time_ns(void *handler)
 {
-  return sc_core::sc_time_stamp().value() / 1000;
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  return _this->local_time_ns();
 }
 
-void get_param_list(void *handler, char **list[], size_t *size)
+void advance_time(void *handler, uint64_t time_ns)
 {
-  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
-  assert(Api);
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  _this->advance_local_time(time_ns);
+}
 
-  std::vector<std::string> params = Api->getParamList();
+void TLM2CSCBridge::register_checkpoint(void *opaque,
+                                        tlm2c_checkpoint_save_fn save,
+                                        tlm2c_checkpoint_restore_fn restore)
+{
+  checkpoint_opaque = opaque;
+  checkpoint_save = save;
+  checkpoint_restore = restore;
+}
+
+void register_checkpoint(void *handler, void *opaque,
+                         tlm2c_checkpoint_save_fn save,
+                         tlm2c_checkpoint_restore_fn restore)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  _this->register_checkpoint(opaque, save, restore);
+}
+
+bool TLM2CSCBridge::model_checkpoint_save(std::vector<uint8_t>& blob)
+{
+  size_t size;
+
+  blob.clear();
+  if (!checkpoint_save)
+  {
+    /* A model without state to save. */
+    return true;
+  }
+
+  size = checkpoint_save(checkpoint_opaque, NULL, 0);
+  blob.resize(size);
+  if (size && checkpoint_save(checkpoint_opaque, &blob[0], size) != size)
+  {
+    return false;
+  }
+  return true;
+}
+
+bool TLM2CSCBridge::model_checkpoint_restore(const uint8_t *blob,
+                                             size_t size)
+{
+  if (!checkpoint_restore)
+  {
+    return !size;
+  }
+  return !checkpoint_restore(checkpoint_opaque, blob, size);
+}
+
+param_snapshot *TLM2CSCBridge::get_parameters()
+{
+  return &this->parameters;
+}
+
+void get_param_list(void *handler, char **list[], size_t *size)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  std::vector<std::string> params = _this->get_parameters()->names();
 
   *list = (char **)malloc(params.size() * sizeof(char *));
   *size = params.size();
@@ -134,38 +420,42 @@ void get_param_list(void *handler, char **list[], size_t *size)
 
 uint64_t get_uint_param(void *handler, const char *name)
 {
-  uint64_t value;
-  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
-  assert(Api);
-
-  Api->getPar(name)->getValue(value);
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  uint64_t value = 0;
 
+  _this->get_parameters()->get_uint(name, &value);
   return value;
 }
 
 int64_t get_int_param(void *handler, const char *name)
 {
-  int64_t value;
-  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
-  assert(Api);
-
-  Api->getPar(name)->getValue(value);
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  int64_t value = 0;
 
+  _this->get_parameters()->get_int(name, &value);
   return value;
 }
 
 void get_string_param(void *handler, const char *name, char **param)
 {
-  std::string value;
-  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
-  assert(Api);
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  const char *value = _this->get_parameters()->get_string(name);
 
-  *param = NULL;
-  if (Api->getPar(name))
-  {
-    Api->getPar(name)->getValue(value);
-    *param = strdup(value.c_str());
-  }
+  /* The Environment hands out a copy the model frees. */
+  *param = value ? strdup(value) : NULL;
+}
+
+const char *get_param_string(void *handler, const char *name)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  return _this->get_parameters()->get_string(name);
+}
+
+size_t get_params(void *handler, const char *prefix, const char **names,
+                  const char **values, size_t max)
+{
+  TLM2CSCBridge *_this = (TLM2CSCBridge *)handler;
+  return _this->get_parameters()->get_all(prefix, names, values, max);
 }
 
 void signal_end_of_quantum(void *handler)
@@ -184,8 +474,7 @@ void TLM2CSCBridge::loadLibrary()
 {
   char *error = NULL;
   std::string lib = libraryName;
-  std::stringstream stream;
-  std::string copyCommand;
+  int occurence = 0;
 
   if (lib == "no")
   {
@@ -193,31 +482,22 @@ void TLM2CSCBridge::loadLibrary()
                             "Set 'library' param with the library to load.");
   }
 
-  /*
-   * There are no way of loading a library twice without sharing the global
-   * variables. So this make a copy of the library and load the copy.
-   */
   for (size_t i = 0; i < libraryNames.size(); i++)
   {
     if (libraryNames[i] == lib)
     {
       /*
-       * We already have this library. Just append the library occurence and
-       * copy the file.
+       * We already have this library. Just append the library occurence, this
+       * instance needs its own copy.
        */
-      (libraryOccurence[i])++;
-      stream.clear();
-      stream.str("");
-      stream << libraryOccurence[i];
-      libraryAssociated = lib + stream.str();
-      copyCommand = "cp " + lib + " " + libraryAssociated;
-      system(copyCommand.c_str());
-      this->removeLibrary = true;
+      occurence = ++(libraryOccurence[i]);
       break;
     }
   }
 
-  if (!this->removeLibrary)
+  this->libraryAssociated = lib;
+  dlerror();
+  if (!occurence)
   {
     /*
      * This is the first load.. We don't have to copy the library.
@@ -225,15 +505,17 @@ void TLM2CSCBridge::loadLibrary()
      */
     libraryNames.push_back(lib);
     libraryOccurence.push_back(0);
-    this->libraryAssociated = lib;
+    libraryHandle = dlopen(lib.c_str(), RTLD_LAZY);
+  }
+  else
+  {
+    /*
+     * More than one instance of a library can be inited.
+     * There are no way of loading a library twice with dlopen without sharing
+     * the global variables.
+     */
+    libraryHandle = this->openLibraryInstance(lib, occurence);
   }
-
-  /*
-   * More than one instance of a library can be inited.
-   * This requires the library to be loaded more than one time.
-   */
-  dlerror();
-  libraryHandle = dlopen(this->libraryAssociated.c_str(), RTLD_LAZY);
   error = dlerror();
 
   if (libraryHandle == NULL)
@@ -259,11 +541,151 @@ void TLM2CSCBridge::loadLibrary()
 
 }
 
+void *TLM2CSCBridge::openLibraryInstance(const std::string& lib,
+                                         int occurence)
+{
+  std::string loader = libraryLoader;
+  void *handle;
+
+  if (loader == "dlmopen")
+  {
+#ifdef LM_ID_NEWLM
+    return dlmopen(LM_ID_NEWLM, lib.c_str(), RTLD_LAZY);
+#else
+    SC_REPORT_ERROR(name(), "library_loader 'dlmopen' isn't available.");
+    return NULL;
+#endif
+  }
+
+  if (loader == "auto" || loader == "memfd")
+  {
+    handle = this->openLibraryMemfd(lib);
+    if (handle || loader == "memfd")
+    {
+      return handle;
+    }
+  }
+  else if (loader != "copy")
+  {
+    SC_REPORT_ERROR(name(), ("Unknown library_loader '" + loader + "':\n"
+                             "Use 'auto', 'memfd', 'copy' or 'dlmopen'.")
+                             .c_str());
+    return NULL;
+  }
+
+  return this->openLibraryCopy(lib, occurence);
+}
+
+void *TLM2CSCBridge::openLibraryMemfd(const std::string& lib)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+  std::stringstream path;
+  char buffer[65536];
+  ssize_t size = 0;
+  void *handle;
+  int fd;
+
+  fd = open(lib.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+
+  libraryFd = syscall(SYS_memfd_create,
+                      lib.substr(lib.find_last_of('/') + 1).c_str(), 0);
+  while (libraryFd >= 0)
+  {
+    size = read(fd, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (size <= 0)
+    {
+      break;
+    }
+    if (write(libraryFd, buffer, size) != size)
+    {
+      ::close(libraryFd);
+      libraryFd = -1;
+    }
+  }
+  ::close(fd);
+  if (size < 0 && libraryFd >= 0)
+  {
+    /* A read error isn't the end of the file: don't load a truncated copy. */
+    ::close(libraryFd);
+    libraryFd = -1;
+  }
+  if (libraryFd < 0)
+  {
+    return NULL;
+  }
+
+  /*
+   * The memfd stays open until cleanLibrary(): dlopen() would hand back the
+   * same handle if another instance reused the descriptor number.
+   */
+  path << "/proc/self/fd/" << libraryFd;
+  this->libraryAssociated = path.str();
+  handle = dlopen(this->libraryAssociated.c_str(), RTLD_LAZY);
+  if (!handle)
+  {
+    ::close(libraryFd);
+    libraryFd = -1;
+    this->libraryAssociated = lib;
+  }
+  return handle;
+#else
+  return NULL;
+#endif
+}
+
+void *TLM2CSCBridge::openLibraryCopy(const std::string& lib, int occurence)
+{
+  std::stringstream stream;
+  void *handle;
+
+  stream << lib << occurence;
+  this->libraryAssociated = stream.str();
+
+  {
+    std::ifstream in(lib.c_str(), std::ios::binary);
+    std::ofstream out(this->libraryAssociated.c_str(),
+                      std::ios::binary | std::ios::trunc);
+
+    if (!in.is_open() || !out.is_open() || !(out << in.rdbuf()))
+    {
+      return NULL;
+    }
+  }
+
+  handle = dlopen(this->libraryAssociated.c_str(), RTLD_LAZY);
+#ifndef _WIN32
+  /* The mapping keeps the file alive: nothing is left to clean up. */
+  std::remove(this->libraryAssociated.c_str());
+#else
+  this->removeLibrary = true;
+#endif
+  return handle;
+}
+
 void TLM2CSCBridge::init()
 {
+  tlm2c_bridge_extensions_fn register_extensions;
+
   std::cout << "bridge: tlm2c_elaborate.." << std::endl;
+  this->parameters.enable();
   this->tlm2c_model = this->tlm2c_elaboration(&this->environment);
   this->additional_init();
+
+  /* Optional: older models don't know about the extensions. */
+  register_extensions = (tlm2c_bridge_extensions_fn)dlsym(libraryHandle,
+                                              TLM2C_BRIDGE_EXTENSIONS_SYMBOL);
+  if (register_extensions)
+  {
+    register_extensions(this->tlm2c_model, &this->extensions);
+  }
 }
 
 void TLM2CSCBridge::cleanLibrary()
@@ -273,11 +695,16 @@ void TLM2CSCBridge::cleanLibrary()
     dlclose(this->libraryHandle);
   }
 
+  if (this->libraryFd >= 0)
+  {
+    ::close(this->libraryFd);
+  }
+
   if (this->removeLibrary)
   {
     /*
-     * Remove the shared library created int the libraryInit function.
+     * Remove the shared library copied by openLibraryCopy().
      */
-    system(std::string("rm " + this->libraryAssociated + " -f").c_str());
+    std::remove(this->libraryAssociated.c_str());
   }
 }
@@ -0,0 +1,219 @@
+/*
+ * traffic_record.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+#include "SimpleCPU/traffic_record.h"
+
+#include <string.h>
+
+/* Bigger than the stdio default: the CPU thread writes under the mutex. */
+static const size_t traffic_buffer_size = 1 << 20;
+
+static size_t traffic_padded(uint64_t size)
+{
+  return (size + 7) & ~(uint64_t)7;
+}
+
+traffic_recorder::traffic_recorder():
+  file(NULL),
+  count(0),
+  write_errors(0)
+{
+  pthread_mutex_init(&mtx, NULL);
+}
+
+traffic_recorder::~traffic_recorder()
+{
+  this->close();
+  pthread_mutex_destroy(&mtx);
+}
+
+bool traffic_recorder::open(const std::string& path, uint64_t quantum_ns)
+{
+  traffic_record_header header;
+
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, traffic_buffer_size);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRAFFIC_RECORD_MAGIC, sizeof(TRAFFIC_RECORD_MAGIC));
+  header.version = TRAFFIC_RECORD_VERSION;
+  header.record_size = sizeof(traffic_record);
+  header.quantum_ns = quantum_ns;
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+  {
+    fclose(file);
+    file = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool traffic_recorder::close()
+{
+  bool ok;
+
+  pthread_mutex_lock(&mtx);
+  if (file)
+  {
+    if (fclose(file))
+    {
+      write_errors++;
+    }
+    file = NULL;
+  }
+  ok = !write_errors;
+  pthread_mutex_unlock(&mtx);
+  return ok;
+}
+
+void traffic_recorder::record(const traffic_record& record,
+                              const uint8_t *data)
+{
+  static const uint8_t padding[8] = {0};
+  bool has_data = (record.kind == TRAFFIC_WRITE) && (record.size > 8);
+  size_t pad = traffic_padded(record.size) - record.size;
+  bool ok;
+
+  pthread_mutex_lock(&mtx);
+  /* Closed at the end of the simulation: late records are ignored. */
+  if (file)
+  {
+    ok = fwrite(&record, sizeof(record), 1, file) == 1;
+    if (ok && has_data)
+    {
+      ok = fwrite(data, record.size, 1, file) == 1
+        && (!pad || fwrite(padding, pad, 1, file) == 1);
+    }
+    if (!ok)
+    {
+      write_errors++;
+    }
+    count++;
+  }
+  pthread_mutex_unlock(&mtx);
+}
+
+uint64_t traffic_recorder::get_count()
+{
+  uint64_t records;
+
+  pthread_mutex_lock(&mtx);
+  records = count;
+  pthread_mutex_unlock(&mtx);
+  return records;
+}
+
+uint64_t traffic_recorder::get_write_errors()
+{
+  uint64_t errors;
+
+  pthread_mutex_lock(&mtx);
+  errors = write_errors;
+  pthread_mutex_unlock(&mtx);
+  return errors;
+}
+
+traffic_reader::traffic_reader():
+  file(NULL)
+{
+  memset(&head, 0, sizeof(head));
+}
+
+traffic_reader::~traffic_reader()
+{
+  if (file)
+  {
+    fclose(file);
+  }
+}
+
+bool traffic_reader::open(const std::string& path)
+{
+  file = fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  if (fread(&head, sizeof(head), 1, file) != 1
+      || memcmp(head.magic, TRAFFIC_RECORD_MAGIC, sizeof(TRAFFIC_RECORD_MAGIC))
+      || head.version != TRAFFIC_RECORD_VERSION
+      || head.record_size != sizeof(traffic_record))
+  {
+    fclose(file);
+    file = NULL;
+    return false;
+  }
+  return true;
+}
+
+const traffic_record_header& traffic_reader::header() const
+{
+  return head;
+}
+
+bool traffic_reader::next(traffic_record *record, const uint8_t **data)
+{
+  *data = NULL;
+  if (!file || fread(record, sizeof(*record), 1, file) != 1)
+  {
+    return false;
+  }
+
+  if (record->kind == TRAFFIC_WRITE && record->size > 8)
+  {
+    burst.resize(traffic_padded(record->size));
+    if (fread(&burst[0], burst.size(), 1, file) != 1)
+    {
+      /* Truncated recording: stop at the last complete record. */
+      return false;
+    }
+    *data = &burst[0];
+  }
+  return true;
+}
@@ -0,0 +1,441 @@
+/*
+ * SimpleCPU_bench.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+/*
+ * Handoff benchmark: SimpleCPU instances running the stub model of
+ * bench_model.c against a local target, one JSON object per line:
+ *   SimpleCPU_bench <model library> [instances] [ops] [results file]
+ *                   [name=value..]
+ * Run it with 1, 2, 4.. instances to measure the scaling. Each name=value
+ * sets a parameter of every instance, or the bench parameter itself when the
+ * name starts with "bench.". It exits with 1 when a check of the model failed
+ * or an instance didn't finish.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "SimpleCPU/simpleCPU.h"
+#include "SimpleCPU/IRQ.h"
+#include "SimpleCPU/log2_histogram.h"
+#include "SimpleCPU/host_time.h"
+#include "bench_protocol.h"
+
+static const char *bench_kind_names[BENCH_RESULT_KINDS] =
+{
+  "mmio_read",
+  "mmio_write",
+  "dmi_read",
+  "dmi_write",
+  "burst_read",
+  "burst_write",
+  "quantum_switch",
+  "mmio_issue",
+  "fpga"
+};
+
+/* Parameters read by the stub model. */
+class bench_config:
+  public sc_core::sc_module
+{
+  public:
+  bench_config(sc_core::sc_module_name name, uint64_t ops_count):
+    sc_core::sc_module(name),
+    ops("ops", ops_count),
+    ops_per_quantum("ops_per_quantum", (uint64_t)1000),
+    write_percent("write_percent", (uint64_t)50),
+    irqs("irqs", ops_count / 100 + 1),
+    quanta("quanta", ops_count / 10 + 1),
+    issue("issue", (uint64_t)0),
+    fpga("fpga", (uint64_t)0)
+  {
+  }
+
+  gs::gs_param<uint64_t> ops;
+  gs::gs_param<uint64_t> ops_per_quantum;
+  gs::gs_param<uint64_t> write_percent;
+  gs::gs_param<uint64_t> irqs;
+  gs::gs_param<uint64_t> quanta;
+  gs::gs_param<uint64_t> issue;
+  gs::gs_param<uint64_t> fpga;
+};
+
+/*
+ * What a CPU sees: RAM reachable through DMI, the bench registers and an IRQ
+ * line pulsed on request.
+ */
+class bench_target:
+  public sc_core::sc_module,
+  public gs::tlm_b_if<gs::gp::GenericSlaveAccessHandle>
+{
+  public:
+  SC_HAS_PROCESS(bench_target);
+  bench_target(sc_core::sc_module_name name, const std::string& cpu,
+               std::ostream& results);
+
+  gs::gp::GenericSlavePort<32> target_port;
+  gs_generic_signal::initiator_signal_socket irq_socket;
+
+  void b_transact(gs::gp::GenericSlaveAccessHandle ah);
+  bool get_direct_mem_ptr(tlm::tlm_generic_payload& payload,
+                          tlm::tlm_dmi& dmi);
+  /* Every instance wrote DONE without a failed check. */
+  static bool passed();
+
+  private:
+  typedef gs::gp::GenericSlavePort<32>::accessHandle accessHandle;
+  std::string cpu;
+  std::ostream& results;
+  std::vector<uint8_t> ram;
+  uint64_t registers[BENCH_REG_DONE / 8 + 1];
+
+  void register_write(uint64_t offset, uint64_t value);
+  void report();
+
+  void irq_pulses();
+  void send_irq(bool level);
+  sc_core::sc_event irq_start_evt;
+  sc_core::sc_event irq_ack_evt;
+  uint64_t irq_pending;
+  uint64_t irq_raised_ns;
+  log2_histogram irq_latency;
+
+  static int running;           /*<! Instances which didn't write DONE. */
+  static int failed;            /*<! Instances with failed checks. */
+};
+
+int bench_target::running = 0;
+int bench_target::failed = 0;
+
+bench_target::bench_target(sc_core::sc_module_name name,
+                           const std::string& cpu, std::ostream& results):
+  sc_core::sc_module(name),
+  target_port("target_port"),
+  irq_socket("irq_socket"),
+  cpu(cpu),
+  results(results),
+  ram(BENCH_RAM_SIZE),
+  irq_pending(0),
+  irq_raised_ns(0)
+{
+  gs::socket::config<gs_generic_signal::gs_generic_signal_protocol_types> cnf;
+
+  memset(registers, 0, sizeof(registers));
+  target_port.bind_b_if(*this);
+  target_port.register_get_direct_mem_ptr(this,
+                                          &bench_target::get_direct_mem_ptr);
+  cnf.use_mandatory_extension<IRQ_LINE_EXTENSION>();
+  irq_socket.set_config(cnf);
+  running++;
+
+  SC_THREAD(irq_pulses);
+}
+
+void bench_target::b_transact(gs::gp::GenericSlaveAccessHandle ah)
+{
+  accessHandle t = _getSlaveAccessHandle(ah);
+  uint64_t address = t->getMAddr();
+  uint64_t size = t->getMBurstLength();
+  uint8_t *data = (uint8_t *)t->getMData().getData();
+  bool write = (t->getMCmd() == gs::Generic_MCMD_WR);
+  uint64_t value = 0;
+
+  t->setSResp(gs::Generic_SRESP_DVA);
+  if (address >= BENCH_RAM_BASE && size <= BENCH_RAM_SIZE
+      && address - BENCH_RAM_BASE <= BENCH_RAM_SIZE - size)
+  {
+    /* Bursts and accesses made before the DMI was granted. */
+    uint8_t *host = &ram[address - BENCH_RAM_BASE];
+
+    if (write)
+    {
+      memcpy(host, data, size);
+    }
+    else
+    {
+      memcpy(data, host, size);
+    }
+    return;
+  }
+
+  if (address < BENCH_MMIO_BASE || size > 8
+      || address - BENCH_MMIO_BASE > BENCH_REG_DONE)
+  {
+    t->setSResp(gs::Generic_SRESP_ERR);
+    return;
+  }
+
+  if (write)
+  {
+    memcpy(&value, data, size);
+    this->register_write(address - BENCH_MMIO_BASE, value);
+  }
+  else
+  {
+    memcpy(data, &registers[(address - BENCH_MMIO_BASE) / 8], size);
+  }
+}
+
+bool bench_target::get_direct_mem_ptr(tlm::tlm_generic_payload& payload,
+                                      tlm::tlm_dmi& dmi)
+{
+  if (payload.get_address() < BENCH_RAM_BASE
+      || payload.get_address() >= BENCH_RAM_BASE + BENCH_RAM_SIZE)
+  {
+    return false;
+  }
+
+  dmi.set_dmi_ptr(&ram[0]);
+  dmi.set_start_address(BENCH_RAM_BASE);
+  dmi.set_end_address(BENCH_RAM_BASE + BENCH_RAM_SIZE - 1);
+  dmi.allow_read_write();
+  return true;
+}
+
+void bench_target::register_write(uint64_t offset, uint64_t value)
+{
+  registers[offset / 8] = value;
+
+  switch (offset)
+  {
+    case BENCH_REG_IRQ_START:
+      irq_pending = value;
+      irq_start_evt.notify(sc_core::SC_ZERO_TIME);
+      break;
+    case BENCH_REG_IRQ_ACK:
+      if (value > irq_raised_ns)
+      {
+        irq_latency.add(value - irq_raised_ns);
+      }
+      irq_ack_evt.notify(sc_core::SC_ZERO_TIME);
+      break;
+    case BENCH_REG_RESULT_KIND:
+      this->report();
+      break;
+    case BENCH_REG_DONE:
+      if (registers[BENCH_REG_ERRORS / 8])
+      {
+        std::cerr << cpu << ": " << registers[BENCH_REG_ERRORS / 8]
+                  << " check(s) failed." << std::endl;
+        failed++;
+      }
+      results << "{\"cpu\":\"" << cpu << "\",\"bench\":\"irq_latency\""
+              << ",\"count\":" << irq_latency.count()
+              << ",\"mean_ns\":" << irq_latency.mean()
+              << ",\"p50_ns\":" << irq_latency.percentile(50)
+              << ",\"p99_ns\":" << irq_latency.percentile(99)
+              << ",\"max_ns\":" << irq_latency.max() << "}" << std::endl;
+      if (!--running)
+      {
+        sc_core::sc_stop();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+bool bench_target::passed()
+{
+  if (running)
+  {
+    std::cerr << running << " instance(s) didn't finish." << std::endl;
+  }
+  return !running && !failed;
+}
+
+void bench_target::report()
+{
+  uint64_t kind = registers[BENCH_REG_RESULT_KIND / 8];
+  uint64_t size = registers[BENCH_REG_RESULT_SIZE / 8];
+  uint64_t ops = registers[BENCH_REG_RESULT_OPS / 8];
+  uint64_t ns = registers[BENCH_REG_RESULT_NS / 8];
+  double seconds = ns / 1e9;
+
+  if (kind >= BENCH_RESULT_KINDS)
+  {
+    return;
+  }
+
+  results << "{\"cpu\":\"" << cpu << "\",\"bench\":\""
+          << bench_kind_names[kind] << "\",\"size\":" << size
+          << ",\"ops\":" << ops << ",\"ns\":" << ns
+          << ",\"ns_per_op\":" << (ops ? (double)ns / ops : 0.0)
+          << ",\"ops_per_s\":" << (ns ? ops / seconds : 0.0)
+          << ",\"mb_per_s\":" << (ns ? size * ops / seconds / 1e6 : 0.0)
+          << "}" << std::endl;
+}
+
+void bench_target::irq_pulses()
+{
+  while (true)
+  {
+    wait(irq_start_evt);
+    for (; irq_pending; irq_pending--)
+    {
+      irq_raised_ns = host_time_ns();
+      this->send_irq(true);
+      wait(irq_ack_evt);
+      this->send_irq(false);
+    }
+  }
+}
+
+void bench_target::send_irq(bool level)
+{
+  gs_generic_signal::gs_generic_signal_payload *payload;
+  sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+  IRQ_ext_data data;
+
+  data.irq_line = BENCH_IRQ_LINE;
+  data.value = level;
+  payload = irq_socket.get_transaction();
+  irq_socket.validate_extension<IRQ_LINE_EXTENSION>(*payload);
+  payload->set_data_ptr((unsigned char *)&data);
+  irq_socket->b_transport(*payload, delay);
+  irq_socket.release_transaction(payload);
+}
+
+int sc_main(int argc, char *argv[])
+{
+  gs::ctr::GC_Core core;
+  gs::cnf::ConfigDatabase database("ConfigDatabase");
+  gs::cnf::ConfigPlugin plugin(&database);
+  gs::cnf::cnf_api *Api = gs::cnf::GCnf_Api::getApiInstance(NULL);
+  std::vector<SimpleCPU *> cpus;
+  std::vector<bench_target *> targets;
+  std::vector<const char *> args;
+  std::vector<std::string> settings;
+  std::ofstream file;
+  std::ostream *results = &std::cout;
+  size_t instances = 1;
+  uint64_t ops = 100000;
+  uint64_t start_ns;
+  bool fpga = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strchr(argv[i], '='))
+    {
+      settings.push_back(argv[i]);
+    }
+    else
+    {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.empty())
+  {
+    std::cerr << "usage: " << argv[0]
+              << " <model library> [instances] [ops] [results file]"
+                 " [name=value..]" << std::endl;
+    return 1;
+  }
+  if (args.size() > 1)
+  {
+    instances = strtoul(args[1], NULL, 0);
+  }
+  if (args.size() > 2)
+  {
+    ops = strtoull(args[2], NULL, 0);
+  }
+  if (args.size() > 3)
+  {
+    file.open(args[3]);
+    results = &file;
+  }
+  for (size_t i = 0; i < settings.size(); i++)
+  {
+    std::string name = settings[i].substr(0, settings[i].find('='));
+    std::string value = settings[i].substr(name.size() + 1);
+
+    if (name.compare(0, 6, "bench.") == 0)
+    {
+      Api->setInitValue(name, value);
+      continue;
+    }
+    for (size_t j = 0; j < instances; j++)
+    {
+      std::stringstream cpu;
+
+      cpu << "cpu" << j << "." << name;
+      Api->setInitValue(cpu.str(), value);
+    }
+    fpga = fpga || (name == "fpga_backend");
+  }
+
+  bench_config config("bench", ops);
+
+  for (size_t i = 0; i < instances; i++)
+  {
+    std::stringstream name;
+
+    name << "cpu" << i;
+    Api->setInitValue(name.str() + ".library", args[0]);
+    cpus.push_back(new SimpleCPU(name.str().c_str()));
+    if (fpga)
+    {
+      /* Everything above the RAM goes to the fpga_backend. */
+      cpus[i]->set_dmi_base_addr(BENCH_FPGA_BASE - 1);
+    }
+    targets.push_back(new bench_target((name.str() + "_target").c_str(),
+                                       name.str(), *results));
+    cpus[i]->master_socket(targets[i]->target_port);
+    targets[i]->irq_socket(cpus[i]->irq_socket);
+  }
+
+  start_ns = host_time_ns();
+  sc_core::sc_start();
+  *results << "{\"bench\":\"run\",\"instances\":" << instances
+           << ",\"ops\":" << ops << ",\"host_ns\":"
+           << host_time_ns() - start_ns << "}" << std::endl;
+
+  /*
+   * The CPU threads of the models are still parked in end_of_quantum(): the
+   * instances aren't deleted, unloading the library under them would crash.
+   */
+  return bench_target::passed() ? 0 : 1;
+}
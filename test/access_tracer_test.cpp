@@ -0,0 +1,197 @@
+/*
+ * access_tracer_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * access_tracer: address filter and sampling, then the records written by the
+ * background thread, whether it was woken up by a full batch or by close().
+ */
+
+#include "SimpleCPU/access_tracer.h"
+#include "test_check.h"
+
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static std::string temporary_path()
+{
+  char path[] = "/tmp/access_tracer_testXXXXXX";
+  int fd = mkstemp(path);
+
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  return path;
+}
+
+static void make_record(access_trace_record *record, uint64_t address)
+{
+  memset(record, 0, sizeof(*record));
+  record->address = address;
+  record->value = ~address;
+  record->size = 4;
+  record->is_write = address & 1;
+}
+
+/* Reads the trace back, false if the header is wrong. */
+static bool read_trace(const std::string& path,
+                       std::vector<access_trace_record>& records)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  access_trace_header header;
+  access_trace_record record;
+  bool valid;
+
+  records.clear();
+  if (!file)
+  {
+    return false;
+  }
+  valid = fread(&header, sizeof(header), 1, file) == 1
+       && !strcmp(header.magic, ACCESS_TRACE_MAGIC)
+       && header.version == ACCESS_TRACE_VERSION
+       && header.record_size == sizeof(access_trace_record);
+  while (valid && fread(&record, sizeof(record), 1, file) == 1)
+  {
+    records.push_back(record);
+  }
+  fclose(file);
+  return valid;
+}
+
+static void test_filter_sampling()
+{
+  access_tracer tracer;
+  int picked = 0;
+
+  CHECK(tracer.wants(0));
+  tracer.set_filter(0x1000, 0x1FFF);
+  CHECK(!tracer.wants(0xFFF));
+  CHECK(tracer.wants(0x1000));
+  CHECK(tracer.wants(0x1FFF));
+  CHECK(!tracer.wants(0x2000));
+
+  /* One in three of the accesses inside the filter, the third one first. */
+  tracer.set_sampling(3);
+  CHECK(!tracer.wants(0x1000));
+  CHECK(!tracer.wants(0x1000));
+  CHECK(tracer.wants(0x1000));
+  for (int i = 0; i < 30; i++)
+  {
+    picked += tracer.wants(0x1000);
+  }
+  CHECK(picked == 10);
+}
+
+static void test_close_drains()
+{
+  std::string path = temporary_path();
+  std::vector<access_trace_record> records;
+  access_trace_record record;
+  access_tracer tracer;
+
+  /* Too few records to wake the writer up: close() writes them. */
+  CHECK(tracer.open(path));
+  for (uint64_t i = 0; i < 10; i++)
+  {
+    make_record(&record, i);
+    tracer.record(record);
+  }
+  tracer.close();
+
+  CHECK(read_trace(path, records));
+  CHECK(records.size() == 10);
+  for (size_t i = 0; i < records.size(); i++)
+  {
+    CHECK(records[i].address == i);
+    CHECK(records[i].value == ~(uint64_t)i);
+  }
+  CHECK(tracer.get_dropped() == 0);
+  unlink(path.c_str());
+}
+
+static void test_batches()
+{
+  std::string path = temporary_path();
+  std::vector<access_trace_record> records;
+  access_trace_record record;
+  access_tracer tracer;
+  const uint64_t count = 100000;
+  bool ordered = true;
+
+  /*
+   * Many times the ring: the writer is woken up by the producer. Whatever
+   * didn't fit is counted, the rest comes out in order.
+   */
+  CHECK(tracer.open(path));
+  for (uint64_t i = 0; i < count; i++)
+  {
+    make_record(&record, i);
+    tracer.record(record);
+    if (!(i & 0xFF))
+    {
+      usleep(10);
+    }
+  }
+  tracer.close();
+
+  CHECK(read_trace(path, records));
+  CHECK(records.size() + tracer.get_dropped() == count);
+  CHECK(records.size() > 0);
+  for (size_t i = 1; i < records.size(); i++)
+  {
+    ordered &= records[i].address > records[i - 1].address;
+  }
+  CHECK(ordered);
+  unlink(path.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+  test_filter_sampling();
+  test_close_drains();
+  test_batches();
+  return test_result();
+}
@@ -0,0 +1,514 @@
+/*
+ * bench_model.c
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+/*
+ * Stub tlm2c model for SimpleCPU_bench. It exports the sockets a qbox library
+ * exports and, once the simulation starts, runs from its own thread a fixed
+ * sequence of accesses standing for a CPU, timing each phase on the host:
+ *   - MMIO reads and writes mixed according to bench.write_percent,
+ *   - DMI reads and writes of 1 to 8 bytes, and bursts when the bridge offers
+ *     memory_burst,
+ *   - IRQ pulses sent by the bench, acknowledged with the host time they were
+ *     seen at,
+ *   - bench.quanta empty quanta,
+ *   - with bench.issue, MMIO accesses through memory_issue,
+ *   - with bench.fpga, accesses the bench routes to an fpga_backend.
+ * Every value read back is checked. The results and the number of failed
+ * checks are written to the bench target which prints them.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SimpleCPU/tlm2cExtensions.h"
+#include "SimpleCPU/host_time.h"
+#include "bench_protocol.h"
+
+typedef struct bench_model
+{
+  Environment *env;
+  Model *model;
+  InitiatorSocket *memory;
+  TargetSocket *irq;
+  GenericPayload *payload;
+  const BridgeExtensions *extensions;
+  int started;
+  pthread_t thread;
+
+  uint64_t ops;                 /*<! Accesses per phase. */
+  uint64_t ops_per_quantum;
+  uint64_t write_percent;
+  uint64_t irqs;
+  uint64_t quanta;
+  uint64_t issue;
+  uint64_t fpga;
+
+  uint64_t in_quantum;
+  uint64_t errors;
+  uint64_t irq_seen_ns;         /*<! Set by the IRQ handler, 0: none. */
+  uint64_t irq_acks;
+} bench_model;
+
+/* Every instance loads its own copy of the library. */
+static bench_model bench;
+
+/* The bridge fills this entry of its extension table. */
+#define BENCH_HAS(entry)                                                    \
+  (bench.extensions                                                         \
+   && bench.extensions->size >= offsetof(BridgeExtensions, entry)           \
+                                + sizeof(bench.extensions->entry)           \
+   && bench.extensions->entry)
+
+static void bench_fail(const char *what, uint64_t address, uint64_t value,
+                       uint64_t expected)
+{
+  /* The first few are enough to tell what went wrong. */
+  if (bench.errors++ < 10)
+  {
+    fprintf(stderr, "bench: %s at 0x%" PRIx64 ": 0x%" PRIx64
+            " instead of 0x%" PRIx64 "\n", what, address, value, expected);
+  }
+}
+
+static uint64_t bench_param(const char *name, uint64_t value)
+{
+  uint64_t set = bench.env->get_uint_param(bench.env->handler, name);
+  return set ? set : value;
+}
+
+static uint64_t bench_raw_access(Command cmd, uint64_t address,
+                                 uint64_t value, uint64_t size)
+{
+  payload_set_command(bench.payload, cmd);
+  payload_set_address(bench.payload, address);
+  payload_set_size(bench.payload, size);
+  payload_set_value(bench.payload, value);
+  b_transport(bench.memory, (Payload *)bench.payload);
+  return payload_get_value(bench.payload);
+}
+
+/* Called after every access, like a CPU between two instructions. */
+static void bench_step(void)
+{
+  uint64_t seen = __atomic_exchange_n(&bench.irq_seen_ns, 0,
+                                      __ATOMIC_ACQ_REL);
+
+  if (seen)
+  {
+    bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_IRQ_ACK, seen, 8);
+    bench.irq_acks++;
+  }
+
+  /* Decoupled, the quantum also ends once its time is consumed. */
+  if (BENCH_HAS(advance_time))
+  {
+    bench.extensions->advance_time(bench.extensions->handler, 10);
+  }
+  if (++bench.in_quantum >= bench.ops_per_quantum)
+  {
+    bench.in_quantum = 0;
+    bench.env->end_of_quantum(bench.env->handler);
+  }
+}
+
+static uint64_t bench_access(Command cmd, uint64_t address, uint64_t value,
+                             uint64_t size)
+{
+  value = bench_raw_access(cmd, address, value, size);
+  bench_step();
+  return value;
+}
+
+static void bench_report(enum bench_result_kind kind, uint64_t size,
+                         uint64_t ops, uint64_t ns)
+{
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_RESULT_SIZE, size, 8);
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_RESULT_OPS, ops, 8);
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_RESULT_NS, ns, 8);
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_RESULT_KIND, kind, 8);
+}
+
+static void bench_mmio(void)
+{
+  uint64_t ns[2] = {0, 0};
+  uint64_t ops[2] = {0, 0};
+  uint64_t written = 0;
+  uint64_t value;
+  uint64_t start;
+  int write;
+
+  for (uint64_t i = 0; i < bench.ops; i++)
+  {
+    write = (i % 100) < bench.write_percent;
+    start = host_time_ns();
+    value = bench_access(write ? WRITE : READ,
+                         BENCH_MMIO_BASE + BENCH_REG_SCRATCH, i, 4);
+    ns[write] += host_time_ns() - start;
+    ops[write]++;
+    if (write)
+    {
+      written = i & 0xFFFFFFFF;
+    }
+    else if ((value & 0xFFFFFFFF) != written)
+    {
+      bench_fail("scratch read", BENCH_MMIO_BASE + BENCH_REG_SCRATCH, value,
+                 written);
+    }
+  }
+  bench_report(BENCH_MMIO_READ, 4, ops[0], ns[0]);
+  bench_report(BENCH_MMIO_WRITE, 4, ops[1], ns[1]);
+}
+
+/* What the write phase left at the address read at step i. */
+static uint64_t bench_dmi_expected(uint64_t i, uint64_t size)
+{
+  uint64_t slots = BENCH_RAM_SIZE / size;
+  uint64_t last = i + (bench.ops - 1 - i) / slots * slots;
+
+  return (size == 8) ? last : last & (((uint64_t)1 << (size * 8)) - 1);
+}
+
+/* A burst written and read back, then seen by a plain access. */
+static void bench_burst_check(void)
+{
+  int (*burst)(void *, Command, uint64_t, uint8_t *, size_t);
+  uint8_t pattern[256];
+  uint8_t check[256];
+  uint64_t value;
+  int status;
+
+  burst = bench.extensions->memory_burst;
+  for (size_t i = 0; i < sizeof(pattern); i++)
+  {
+    pattern[i] = i * 31 + 7;
+  }
+  memset(check, 0, sizeof(check));
+
+  status = burst(bench.extensions->handler, WRITE, BENCH_RAM_BASE, pattern,
+                 sizeof(pattern));
+  if (status != OK_RESPONSE)
+  {
+    bench_fail("burst write status", BENCH_RAM_BASE, status, OK_RESPONSE);
+  }
+  status = burst(bench.extensions->handler, READ, BENCH_RAM_BASE, check,
+                 sizeof(check));
+  if (status != OK_RESPONSE)
+  {
+    bench_fail("burst read status", BENCH_RAM_BASE, status, OK_RESPONSE);
+  }
+  for (size_t i = 0; i < sizeof(pattern); i++)
+  {
+    if (check[i] != pattern[i])
+    {
+      bench_fail("burst read", BENCH_RAM_BASE + i, check[i], pattern[i]);
+      break;
+    }
+  }
+
+  value = bench_raw_access(READ, BENCH_RAM_BASE, 0, 8);
+  if (memcmp(&value, pattern, sizeof(value)))
+  {
+    bench_fail("read after burst", BENCH_RAM_BASE, value,
+               *(uint64_t *)pattern);
+  }
+}
+
+static void bench_dmi(void)
+{
+  static uint8_t buffer[4096];
+  static const uint64_t burst_sizes[] = {64, 4096};
+  int (*burst)(void *, Command, uint64_t, uint8_t *, size_t);
+  uint64_t address;
+  uint64_t value;
+  uint64_t start;
+
+  for (uint64_t size = 1; size <= 8; size *= 2)
+  {
+    start = host_time_ns();
+    for (uint64_t i = 0; i < bench.ops; i++)
+    {
+      bench_access(WRITE, BENCH_RAM_BASE + (i * size) % BENCH_RAM_SIZE, i,
+                   size);
+    }
+    bench_report(BENCH_DMI_WRITE, size, bench.ops, host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint64_t i = 0; i < bench.ops; i++)
+    {
+      address = BENCH_RAM_BASE + (i * size) % BENCH_RAM_SIZE;
+      value = bench_access(READ, address, 0, size);
+      if (value != bench_dmi_expected(i, size))
+      {
+        bench_fail("RAM read", address, value, bench_dmi_expected(i, size));
+      }
+    }
+    bench_report(BENCH_DMI_READ, size, bench.ops, host_time_ns() - start);
+  }
+
+  if (!BENCH_HAS(memory_burst))
+  {
+    return;
+  }
+  burst = bench.extensions->memory_burst;
+  bench_burst_check();
+
+  for (size_t s = 0; s < sizeof(burst_sizes) / sizeof(burst_sizes[0]); s++)
+  {
+    uint64_t size = burst_sizes[s];
+    uint64_t count = bench.ops / 16 + 1;
+
+    start = host_time_ns();
+    for (uint64_t i = 0; i < count; i++)
+    {
+      burst(bench.extensions->handler, READ,
+            BENCH_RAM_BASE + (i * size) % BENCH_RAM_SIZE, buffer, size);
+      bench_step();
+    }
+    bench_report(BENCH_BURST_READ, size, count, host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint64_t i = 0; i < count; i++)
+    {
+      burst(bench.extensions->handler, WRITE,
+            BENCH_RAM_BASE + (i * size) % BENCH_RAM_SIZE, buffer, size);
+      bench_step();
+    }
+    bench_report(BENCH_BURST_WRITE, size, count, host_time_ns() - start);
+  }
+}
+
+static void bench_irq_pulses(void)
+{
+  /* Give up if the bench never sends them rather than hang. */
+  uint64_t polls = (bench.irqs + 1) * 100000;
+
+  bench.irq_acks = 0;
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_IRQ_START, bench.irqs,
+                   8);
+  while (bench.irq_acks < bench.irqs && polls--)
+  {
+    bench_access(READ, BENCH_MMIO_BASE + BENCH_REG_SCRATCH, 0, 4);
+  }
+  if (bench.irq_acks < bench.irqs)
+  {
+    bench_fail("IRQ pulses seen", BENCH_MMIO_BASE + BENCH_REG_IRQ_ACK,
+               bench.irq_acks, bench.irqs);
+  }
+}
+
+/* Writes and read backs of the scratch register, a batch in flight. */
+static void bench_issue(void)
+{
+  enum { batch = 8 };
+  uint32_t written[batch];
+  uint32_t read[batch];
+  uint64_t address = BENCH_MMIO_BASE + BENCH_REG_SCRATCH;
+  uint64_t count = bench.ops / batch + 1;
+  uint64_t start;
+  uint64_t tag;
+  int status;
+
+  if (!bench.issue || !BENCH_HAS(memory_issue) || !BENCH_HAS(memory_collect))
+  {
+    return;
+  }
+
+  start = host_time_ns();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    for (uint32_t k = 0; k < batch; k++)
+    {
+      written[k] = i * batch + k;
+      read[k] = ~written[k];
+      bench.extensions->memory_issue(bench.extensions->handler, WRITE,
+                                     address, (uint8_t *)&written[k], 4,
+                                     2 * k);
+      bench.extensions->memory_issue(bench.extensions->handler, READ,
+                                     address, (uint8_t *)&read[k], 4,
+                                     2 * k + 1);
+    }
+    while (bench.extensions->memory_collect(bench.extensions->handler, &tag,
+                                            &status, 1) == 1)
+    {
+      if (status != OK_RESPONSE)
+      {
+        bench_fail("issued access status", address, status, OK_RESPONSE);
+      }
+    }
+    /* Done in issue order: each read sees the write just before it. */
+    for (uint32_t k = 0; k < batch; k++)
+    {
+      if (read[k] != written[k])
+      {
+        bench_fail("issued read", address, read[k], written[k]);
+      }
+    }
+    bench_step();
+  }
+  bench_report(BENCH_MMIO_ISSUE, 4, count * batch * 2,
+               host_time_ns() - start);
+}
+
+static void bench_fpga(void)
+{
+  uint64_t address;
+  uint64_t value;
+  uint64_t start;
+
+  if (!bench.fpga)
+  {
+    return;
+  }
+
+  start = host_time_ns();
+  for (uint64_t i = 0; i < bench.ops; i++)
+  {
+    address = BENCH_FPGA_BASE + (i * 8) % BENCH_FPGA_SIZE;
+    bench_access(WRITE, address, i, 8);
+    value = bench_access(READ, address, 0, 8);
+    if (value != i)
+    {
+      bench_fail("fpga read", address, value, i);
+    }
+  }
+  bench_report(BENCH_FPGA_ACCESS, 8, bench.ops * 2, host_time_ns() - start);
+}
+
+static void bench_quantum(void)
+{
+  uint64_t start = host_time_ns();
+
+  for (uint64_t i = 0; i < bench.quanta; i++)
+  {
+    bench.env->end_of_quantum(bench.env->handler);
+  }
+  bench.in_quantum = 0;
+  bench_report(BENCH_QUANTUM_SWITCH, 0, bench.quanta,
+               host_time_ns() - start);
+}
+
+static void *bench_thread(void *opaque)
+{
+  bench.ops = bench_param("bench.ops", 100000);
+  bench.ops_per_quantum = bench_param("bench.ops_per_quantum", 1000);
+  bench.write_percent = bench_param("bench.write_percent", 50);
+  bench.irqs = bench_param("bench.irqs", 1000);
+  bench.quanta = bench_param("bench.quanta", 10000);
+  bench.issue = bench_param("bench.issue", 0);
+  bench.fpga = bench_param("bench.fpga", 0);
+
+  /* The first end_of_quantum() tells the bridge the CPU is ready. */
+  bench.env->end_of_quantum(bench.env->handler);
+
+  bench_mmio();
+  bench_dmi();
+  bench_irq_pulses();
+  bench_issue();
+  bench_fpga();
+  bench_quantum();
+
+  /* The bench stops once every instance is done: keep the quanta going. */
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_ERRORS, bench.errors,
+                   8);
+  bench_raw_access(WRITE, BENCH_MMIO_BASE + BENCH_REG_DONE, 1, 8);
+  while (1)
+  {
+    bench.env->end_of_quantum(bench.env->handler);
+  }
+  return NULL;
+}
+
+static void bench_notify(void *opaque)
+{
+  /*
+   * The first notification comes when the simulation starts, with every
+   * socket bound.
+   */
+  if (!bench.started)
+  {
+    bench.started = 1;
+    pthread_create(&bench.thread, NULL, bench_thread, NULL);
+  }
+}
+
+static void bench_irq(void *opaque, Payload *p)
+{
+  if (payload_get_value((GenericPayload *)p))
+  {
+    __atomic_store_n(&bench.irq_seen_ns, host_time_ns(), __ATOMIC_RELEASE);
+  }
+  payload_set_response_status((GenericPayload *)p, OK_RESPONSE);
+}
+
+Model *tlm2c_elaboration(Environment *environment)
+{
+  memset(&bench, 0, sizeof(bench));
+  bench.env = environment;
+  bench.memory = socket_initiator_create("qbox.memory_master");
+  bench.irq = socket_target_create("qbox.irq_slave");
+  socket_target_register_b_transport(bench.irq, &bench, bench_irq);
+  bench.payload = payload_create();
+  bench.model = model_create(&bench, bench_notify);
+  return bench.model;
+}
+
+Socket *tlm2c_socket_get_by_name(const char *name)
+{
+  if (!strcmp(name, "qbox.memory_master"))
+  {
+    return (Socket *)bench.memory;
+  }
+  if (!strcmp(name, "qbox.irq_slave"))
+  {
+    return (Socket *)bench.irq;
+  }
+  return NULL;
+}
+
+void tlm2c_bridge_extensions(Model *model, const BridgeExtensions *extensions)
+{
+  bench.extensions = extensions;
+}
@@ -0,0 +1,87 @@
+/*
+ * bench_protocol.h
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+
+#ifndef BENCH_PROTOCOL_H
+#define BENCH_PROTOCOL_H
+
+/*
+ * Registers of the bench target, shared by the bench and its stub model. The
+ * model reports its measurements by writing them there so the bench, which
+ * knows the instance names, prints them all.
+ */
+
+#define BENCH_MMIO_BASE         0x10000000ULL
+#define BENCH_RAM_BASE          0x20000000ULL
+#define BENCH_RAM_SIZE          0x00100000ULL
+/* Only used when the bench routes it to an fpga_backend. */
+#define BENCH_FPGA_BASE         0x40000000ULL
+#define BENCH_FPGA_SIZE         0x00001000ULL
+
+#define BENCH_REG_SCRATCH       0x00  /*<! Plain register for the MMIO mix. */
+#define BENCH_REG_IRQ_START     0x08  /*<! Number of IRQ pulses to send. */
+#define BENCH_REG_IRQ_ACK       0x10  /*<! Host ns when the IRQ was seen. */
+#define BENCH_REG_RESULT_SIZE   0x18
+#define BENCH_REG_RESULT_OPS    0x20
+#define BENCH_REG_RESULT_NS     0x28
+#define BENCH_REG_RESULT_KIND   0x30  /*<! Writing it records the result. */
+#define BENCH_REG_ERRORS        0x38  /*<! Checks the model saw failing. */
+#define BENCH_REG_DONE          0x40
+
+#define BENCH_IRQ_LINE          0
+
+enum bench_result_kind
+{
+  BENCH_MMIO_READ = 0,
+  BENCH_MMIO_WRITE,
+  BENCH_DMI_READ,
+  BENCH_DMI_WRITE,
+  BENCH_BURST_READ,
+  BENCH_BURST_WRITE,
+  BENCH_QUANTUM_SWITCH,
+  BENCH_MMIO_ISSUE,
+  BENCH_FPGA_ACCESS,
+  BENCH_RESULT_KINDS
+};
+
+#endif /* !BENCH_PROTOCOL_H */
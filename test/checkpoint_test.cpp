@@ -0,0 +1,198 @@
+/*
+ * checkpoint_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * checkpoint: an image written and opened again, its regions restored by copy
+ * and copy on write, and the damaged images open() refuses.
+ */
+
+#include "SimpleCPU/checkpoint.h"
+#include "test_check.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static const char *image_path = "checkpoint_test.ckp";
+
+static void write_image(const std::vector<uint8_t>& ram,
+                        const std::vector<uint8_t>& rom)
+{
+  checkpoint_writer writer;
+  checkpoint_header state;
+  std::vector<uint8_t> model(13, 0xA5);
+  std::vector<uint64_t> notifications;
+
+  memset(&state, 0, sizeof(state));
+  state.time_ns = 123456789;
+  state.quantum_ns = 1000;
+  notifications.push_back(50);
+  notifications.push_back(7);
+  notifications.push_back(50);
+
+  writer.add_region(0x80000000, 0x80000000 + ram.size() - 1, &ram[0]);
+  writer.add_region(0x1000, 0x1000 + rom.size() - 1, &rom[0]);
+  CHECK(writer.write(image_path, state, model, notifications));
+}
+
+static void test_round_trip()
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  std::vector<uint8_t> ram(page * 4);
+  std::vector<uint8_t> rom(100);
+  checkpoint_image image;
+  uint8_t *host;
+
+  for (size_t i = 0; i < ram.size(); i++)
+  {
+    ram[i] = i * 7;
+  }
+  for (size_t i = 0; i < rom.size(); i++)
+  {
+    rom[i] = 255 - i;
+  }
+  write_image(ram, rom);
+
+  CHECK(image.open(image_path));
+  CHECK(image.header().version == CHECKPOINT_VERSION);
+  CHECK(image.header().time_ns == 123456789);
+  CHECK(image.header().quantum_ns == 1000);
+  CHECK(image.header().region_count == 2);
+  CHECK(image.header().notification_count == 3);
+  if (image.header().region_count != 2
+      || image.header().notification_count != 3)
+  {
+    return;
+  }
+  CHECK(image.notifications()[0] == 50);
+  CHECK(image.notifications()[1] == 7);
+  CHECK(image.notifications()[2] == 50);
+  CHECK(image.header().model_size == 13);
+  CHECK(image.model()[0] == 0xA5 && image.model()[12] == 0xA5);
+
+  /* Region data is page aligned in the file. */
+  CHECK(image.region(0).start == 0x80000000);
+  CHECK(!(image.region(0).offset & (page - 1)));
+  CHECK(image.region(1).start == 0x1000 && image.region(1).end == 0x1063);
+
+  /* By copy. */
+  std::vector<uint8_t> copy(rom.size());
+  CHECK(image.restore_region(1, &copy[0], false));
+  CHECK(copy == rom);
+
+  /* Copy on write: writes stay private to the process. */
+  host = (uint8_t *)mmap(NULL, ram.size(), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(host != MAP_FAILED);
+  if (host == MAP_FAILED)
+  {
+    return;
+  }
+  CHECK(image.restore_region(0, host, true));
+  CHECK(!memcmp(host, &ram[0], ram.size()));
+  host[0] ^= 0xFF;
+  copy.resize(ram.size());
+  CHECK(image.restore_region(0, &copy[0], false));
+  CHECK(copy == ram);
+  munmap(host, ram.size());
+}
+
+static void test_damaged()
+{
+  std::vector<uint8_t> ram(4096, 1);
+  std::vector<uint8_t> rom(100, 2);
+  checkpoint_image missing;
+  FILE *file;
+  long size;
+
+  CHECK(!missing.open("checkpoint_test.missing"));
+
+  /* Cut in the middle of the region data. */
+  write_image(ram, rom);
+  file = fopen(image_path, "r+b");
+  CHECK(file != NULL);
+  if (!file)
+  {
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fclose(file);
+  CHECK(truncate(image_path, size - 50) == 0);
+  {
+    checkpoint_image image;
+    CHECK(!image.open(image_path));
+  }
+
+  /* Too short for a header. */
+  CHECK(truncate(image_path, 10) == 0);
+  {
+    checkpoint_image image;
+    CHECK(!image.open(image_path));
+  }
+
+  /* Another version. */
+  write_image(ram, rom);
+  file = fopen(image_path, "r+b");
+  if (file)
+  {
+    uint32_t version = CHECKPOINT_VERSION + 1;
+
+    fseek(file, sizeof(((checkpoint_header *)0)->magic), SEEK_SET);
+    fwrite(&version, sizeof(version), 1, file);
+    fclose(file);
+  }
+  {
+    checkpoint_image image;
+    CHECK(!image.open(image_path));
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  test_round_trip();
+  test_damaged();
+  unlink(image_path);
+  return test_result();
+}
@@ -0,0 +1,156 @@
+/*
+ * dmi_table_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * dmi_table: lookups around the region bounds, grants replacing what they
+ * overlap, invalidation, and dmi_range_merge().
+ */
+
+#include "SimpleCPU/dmi_table.h"
+#include "test_check.h"
+
+static dmi_region make_region(uint64_t start, uint64_t end)
+{
+  dmi_region region;
+
+  region.start = start;
+  region.end = end;
+  region.pointer = NULL;
+  region.read_allowed = true;
+  region.write_allowed = true;
+  return region;
+}
+
+static void test_lookup()
+{
+  dmi_table table;
+  const dmi_region *region;
+
+  CHECK(!table.lookup(0));
+  table.insert(make_region(0x3000, 0x3fff));
+  table.insert(make_region(0x1000, 0x1fff));
+  CHECK(table.count() == 2);
+  /* Kept sorted whatever the insertion order. */
+  CHECK(table.at(0).start == 0x1000 && table.at(1).start == 0x3000);
+
+  CHECK(!table.lookup(0xfff));
+  region = table.lookup(0x1000);
+  CHECK(region && region->start == 0x1000);
+  region = table.lookup(0x1fff);
+  CHECK(region && region->start == 0x1000);
+  CHECK(!table.lookup(0x2000));
+  region = table.lookup(0x3800);
+  CHECK(region && region->start == 0x3000);
+  /* The last hit must not answer for an address outside it. */
+  CHECK(!table.lookup(0x4000));
+  region = table.lookup(0x1800);
+  CHECK(region && region->start == 0x1000);
+
+  CHECK(region && region->contains(0x1ff8, 8));
+  CHECK(region && !region->contains(0x1ffc, 8));
+}
+
+static void test_replace_invalidate()
+{
+  dmi_table table;
+  const dmi_region *region;
+
+  table.insert(make_region(0x1000, 0x1fff));
+  table.insert(make_region(0x3000, 0x3fff));
+  table.insert(make_region(0x5000, 0x5fff));
+
+  /* A grant overlapping two regions replaces both. */
+  table.insert(make_region(0x1800, 0x37ff));
+  CHECK(table.count() == 2);
+  region = table.lookup(0x1000);
+  CHECK(!region);
+  region = table.lookup(0x3700);
+  CHECK(region && region->start == 0x1800);
+
+  /* Whole regions go, even when the range only overlaps them. */
+  table.lookup(0x5000);
+  table.invalidate(0x5fff, 0x6fff);
+  CHECK(table.count() == 1);
+  CHECK(!table.lookup(0x5000));
+
+  table.clear();
+  CHECK(table.count() == 0);
+  CHECK(!table.lookup(0x2000));
+}
+
+static void test_range_merge()
+{
+  std::vector<dmi_range> ranges;
+
+  dmi_range_merge(ranges, 0x1000, 0x1fff);
+  dmi_range_merge(ranges, 0x4000, 0x4fff);
+  dmi_range_merge(ranges, 0x8000, 0x8fff);
+  CHECK(ranges.size() == 3);
+
+  /* Adjacent ranges merge. */
+  dmi_range_merge(ranges, 0x2000, 0x2fff);
+  CHECK(ranges.size() == 3);
+  CHECK(ranges[0].start == 0x1000 && ranges[0].end == 0x2fff);
+
+  /* Bridging two of them. */
+  dmi_range_merge(ranges, 0x4800, 0x8000);
+  CHECK(ranges.size() == 2);
+  CHECK(ranges[1].start == 0x4000 && ranges[1].end == 0x8fff);
+
+  /* Up to the end of the address space. */
+  dmi_range_merge(ranges, 0x100000, ~(uint64_t)0);
+  dmi_range_merge(ranges, 0x0, 0x100);
+  CHECK(ranges.size() == 4);
+  CHECK(ranges[0].start == 0 && ranges[3].end == ~(uint64_t)0);
+  dmi_range_merge(ranges, 0x9000, 0xfffff);
+  CHECK(ranges.size() == 3);
+  CHECK(ranges[2].start == 0x4000 && ranges[2].end == ~(uint64_t)0);
+}
+
+int main(int argc, char *argv[])
+{
+  test_lookup();
+  test_replace_invalidate();
+  test_range_merge();
+  return test_result();
+}
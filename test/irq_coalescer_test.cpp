@@ -0,0 +1,129 @@
+/*
+ * irq_coalescer_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * irq_coalescer: edges folded into one delivery per line with its last
+ * level, pulses cancelling out, immediate lines and the counters.
+ */
+
+#include "SimpleCPU/irq_coalescer.h"
+#include "test_check.h"
+
+#include <vector>
+
+struct delivery
+{
+  uint32_t line;
+  bool level;
+};
+
+static void record(void *opaque, uint32_t line, bool level)
+{
+  delivery d;
+
+  d.line = line;
+  d.level = level;
+  ((std::vector<delivery> *)opaque)->push_back(d);
+}
+
+static void test_coalescing()
+{
+  irq_coalescer irqs;
+  std::vector<delivery> seen;
+
+  CHECK(!irqs.has_pending());
+  CHECK(irqs.drain(record, &seen) == 0);
+
+  /* One delivery per line, with the level it ended at, lowest line first. */
+  irqs.set_level(700, true);
+  irqs.set_level(3, true);
+  irqs.set_level(3, false);
+  irqs.set_level(3, true);
+  CHECK(irqs.has_pending());
+  CHECK(irqs.drain(record, &seen) == 2);
+  CHECK(!irqs.has_pending());
+  CHECK(seen.size() == 2);
+  if (seen.size() == 2)
+  {
+    CHECK(seen[0].line == 3 && seen[0].level);
+    CHECK(seen[1].line == 700 && seen[1].level);
+  }
+
+  /* The same level again: nothing to deliver. */
+  seen.clear();
+  irqs.set_level(3, true);
+  CHECK(irqs.drain(record, &seen) == 0);
+
+  /* A pulse between two drains cancels out. */
+  irqs.set_level(700, false);
+  irqs.set_level(700, true);
+  CHECK(irqs.drain(record, &seen) == 0);
+  CHECK(seen.empty());
+
+  irqs.set_level(3, false);
+  CHECK(irqs.drain(record, &seen) == 1);
+  CHECK(seen.size() == 1 && seen[0].line == 3 && !seen[0].level);
+
+  CHECK(irqs.get_edges() == 8);
+  CHECK(irqs.get_deliveries() == 3);
+}
+
+static void test_immediate()
+{
+  irq_coalescer irqs;
+
+  CHECK(!irqs.is_immediate(5));
+  irqs.set_immediate(5);
+  CHECK(irqs.is_immediate(5));
+  CHECK(!irqs.is_immediate(4) && !irqs.is_immediate(69));
+  /* Lines the coalescer can't hold are always delivered at once. */
+  CHECK(irqs.is_immediate(irq_coalescer::line_count));
+  irqs.set_immediate(irq_coalescer::line_count);
+}
+
+int main(int argc, char *argv[])
+{
+  test_coalescing();
+  test_immediate();
+  return test_result();
+}
@@ -0,0 +1,124 @@
+/*
+ * log2_histogram_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * log2_histogram: bucket boundaries, percentiles, merge and print.
+ */
+
+#include "SimpleCPU/log2_histogram.h"
+#include "test_check.h"
+
+#include <sstream>
+
+static void test_buckets()
+{
+  log2_histogram h;
+
+  /* Bucket n holds [2^(n-1), 2^n), 0 has its own. */
+  h.add(0);
+  h.add(1);
+  h.add(2);
+  h.add(3);
+  h.add(4);
+  h.add(~(uint64_t)0);
+  CHECK(h.bucket(0) == 1);
+  CHECK(h.bucket(1) == 1);
+  CHECK(h.bucket(2) == 2);
+  CHECK(h.bucket(3) == 1);
+  CHECK(h.bucket(64) == 1);
+  CHECK(h.count() == 6);
+  CHECK(h.max() == ~(uint64_t)0);
+
+  h.clear();
+  CHECK(h.count() == 0 && h.sum() == 0 && h.max() == 0 && h.mean() == 0);
+  CHECK(h.percentile(50) == 0);
+}
+
+static void test_percentiles()
+{
+  log2_histogram h;
+
+  /* 90 fast samples, 10 slow ones. */
+  for (int i = 0; i < 90; i++)
+  {
+    h.add(100);
+  }
+  for (int i = 0; i < 10; i++)
+  {
+    h.add(5000);
+  }
+  CHECK(h.mean() == (90 * 100 + 10 * 5000) / 100);
+  CHECK(h.percentile(50) == 128);
+  CHECK(h.percentile(90) == 128);
+  /* Capped by the largest sample rather than the bucket bound. */
+  CHECK(h.percentile(99) == 5000);
+  CHECK(h.percentile(100) == 5000);
+}
+
+static void test_merge_print()
+{
+  log2_histogram a;
+  log2_histogram b;
+  std::ostringstream out;
+
+  a.add(10);
+  b.add(10);
+  b.add(1000);
+  a.merge(b);
+  CHECK(a.count() == 3);
+  CHECK(a.sum() == 1020);
+  CHECK(a.max() == 1000);
+  CHECK(a.bucket(4) == 2);
+
+  /* One line per non empty bucket. */
+  a.print(out, "  ");
+  CHECK(out.str() == "  [8, 16) 2\n  [512, 1024) 1\n");
+}
+
+int main(int argc, char *argv[])
+{
+  test_buckets();
+  test_percentiles();
+  test_merge_print();
+  return test_result();
+}
@@ -0,0 +1,157 @@
+/*
+ * mmio_profiler_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * mmio_profiler: which region or page an access is accounted to, the report
+ * order, and the table growing past its first size.
+ */
+
+#include "SimpleCPU/mmio_profiler.h"
+#include "test_check.h"
+
+#include <sstream>
+#include <string>
+
+/* The report line of a region and route, "" if there is none. */
+static std::string report_line(const std::string& report,
+                               const std::string& range, const char *route)
+{
+  std::string key = range + " " + route + ":";
+  size_t pos = report.find(key);
+
+  if (pos == std::string::npos)
+  {
+    return "";
+  }
+  return report.substr(pos, report.find('\n', pos) - pos);
+}
+
+static bool has(const std::string& line, const char *text)
+{
+  return line.find(text) != std::string::npos;
+}
+
+static void test_regions()
+{
+  mmio_profiler profiler(12);
+
+  CHECK(profiler.add_region(0x10000, 0x1FFFF));
+  CHECK(profiler.add_region(0x30800, 0x30FFF));
+  /* Overlapping either bound of an existing region. */
+  CHECK(!profiler.add_region(0x1F000, 0x20FFF));
+  CHECK(!profiler.add_region(0x0F000, 0x10000));
+  CHECK(!profiler.add_region(0x30000, 0x40000));
+  CHECK(profiler.add_region(0x20000, 0x207FF));
+}
+
+static void test_accounting()
+{
+  mmio_profiler profiler(12);
+  std::ostringstream os;
+  std::string report;
+  std::string line;
+
+  profiler.add_region(0x10000, 0x1FFFF);
+  profiler.add_region(0x30800, 0x30FFF);
+
+  /* Both ends of the region go to the same line. */
+  profiler.record(0x10010, 4, false, MMIO_ROUTE_DMI, 100, 1000);
+  profiler.record(0x1FFFC, 4, true, MMIO_ROUTE_DMI, 300, 3000);
+  /* Same region, another route: another line. */
+  profiler.record(0x10000, 8, true, MMIO_ROUTE_TRANSACTION, 5000, 10000);
+  /* A page, and one cut short by the region after it. */
+  profiler.record(0x20004, 4, false, MMIO_ROUTE_FPGA, 10, 0);
+  profiler.record(0x30000, 2, false, MMIO_ROUTE_TRANSACTION, 20, 0);
+  profiler.report(os, false);
+  report = os.str();
+
+  CHECK(has(report, "MMIO profile: 4 region/route pairs"));
+  line = report_line(report, "0x0000000000010000-0x000000000001ffff", "dmi");
+  CHECK(has(line, "reads=1 writes=1 bytes=8"));
+  CHECK(has(line, "host_ns(total/mean/p50/p99/max)=400/200/"));
+  CHECK(has(line, "sc_ps(total/mean/p50/p99/max)=4000/2000/"));
+  line = report_line(report, "0x0000000000010000-0x000000000001ffff",
+                     "transaction");
+  CHECK(has(line, "reads=0 writes=1 bytes=8"));
+  line = report_line(report, "0x0000000000020000-0x0000000000020fff", "fpga");
+  CHECK(has(line, "reads=1 writes=0 bytes=4"));
+  line = report_line(report, "0x0000000000030000-0x00000000000307ff",
+                     "transaction");
+  CHECK(has(line, "reads=1 writes=0 bytes=2"));
+
+  /* What cost the most host time comes first. */
+  CHECK(report.find("transaction") < report.find("dmi"));
+  CHECK(report.find("dmi") < report.find("fpga"));
+}
+
+static void test_growth()
+{
+  mmio_profiler profiler(12);
+  std::ostringstream os;
+  std::string report;
+
+  /* Many more pages than the first table holds, each recorded twice. */
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (uint64_t page = 0; page < 1000; page++)
+    {
+      profiler.record(page << 12, 4, pass, MMIO_ROUTE_DMI, 1, 1);
+    }
+  }
+  profiler.report(os, true);
+  report = os.str();
+
+  CHECK(has(report, "MMIO profile: 1000 region/route pairs"));
+  CHECK(has(report_line(report, "0x00000000003e7000-0x00000000003e7fff",
+                        "dmi"),
+            "reads=1 writes=1 bytes=8"));
+  CHECK(has(report, "  host ns:"));
+}
+
+int main(int argc, char *argv[])
+{
+  test_regions();
+  test_accounting();
+  test_growth();
+  return test_result();
+}
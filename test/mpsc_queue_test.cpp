@@ -0,0 +1,148 @@
+/*
+ * mpsc_queue_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * mpsc_queue: order and wrap-around on one thread, then several producer
+ * threads: every item arrives once, in order for each producer.
+ */
+
+#include "SimpleCPU/mpsc_queue.h"
+#include "test_check.h"
+
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+static const uint32_t producer_count = 4;
+static const uint64_t items_per_producer = 200000;
+static mpsc_queue<uint64_t, 16> shared_queue;
+
+static void test_single_thread()
+{
+  mpsc_queue<uint32_t, 4> queue;
+  uint32_t value;
+
+  CHECK(!queue.pop(value));
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    CHECK(queue.push(i));
+  }
+  CHECK(!queue.push(4));
+
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    CHECK(queue.pop(value));
+    CHECK(value == i);
+    CHECK(queue.push(i + 4));
+  }
+  for (uint32_t i = 20; i < 24; i++)
+  {
+    CHECK(queue.pop(value));
+    CHECK(value == i);
+  }
+  CHECK(!queue.pop(value));
+}
+
+static void *producer(void *opaque)
+{
+  /* The producer in the top bits, its sequence number below. */
+  uint64_t id = (uint64_t)(uintptr_t)opaque << 32;
+
+  for (uint64_t i = 0; i < items_per_producer; i++)
+  {
+    while (!shared_queue.push(id | i))
+    {
+      /* Full: let the consumer catch up, even on a single CPU. */
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void test_producers()
+{
+  pthread_t threads[producer_count];
+  std::vector<uint64_t> next(producer_count, 0);
+  uint64_t received = 0;
+  bool ordered = true;
+  uint64_t value;
+  uint32_t id;
+
+  for (uint32_t i = 0; i < producer_count; i++)
+  {
+    CHECK(pthread_create(&threads[i], NULL, producer,
+                         (void *)(uintptr_t)i) == 0);
+  }
+  while (received < producer_count * items_per_producer)
+  {
+    if (!shared_queue.pop(value))
+    {
+      sched_yield();
+      continue;
+    }
+    /* Keep draining on a mismatch, or the producers never finish. */
+    id = value >> 32;
+    if (id < producer_count && (value & 0xFFFFFFFF) == next[id])
+    {
+      next[id]++;
+    }
+    else
+    {
+      ordered = false;
+    }
+    received++;
+  }
+  CHECK(ordered);
+  for (uint32_t i = 0; i < producer_count; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  CHECK(!shared_queue.pop(value));
+}
+
+int main(int argc, char *argv[])
+{
+  test_single_thread();
+  test_producers();
+  return test_result();
+}
@@ -0,0 +1,147 @@
+/*
+ * param_snapshot_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * param_snapshot: values copied on first use, refreshed after a write while
+ * the strings handed out before stay valid, prefix listing, and parameters
+ * destroyed then created again.
+ */
+
+#include <systemc.h>
+#include "SimpleCPU/param_snapshot.h"
+#include "test_check.h"
+
+#include <algorithm>
+#include <string.h>
+
+static bool same(const char *value, const char *expected)
+{
+  return value && !strcmp(value, expected);
+}
+
+static void test_values(param_snapshot& snapshot)
+{
+  gs::gs_param<uint64_t> count("snap_count", 42);
+  gs::gs_param<int> offset("snap_offset", -3);
+  gs::gs_param<std::string> label("snap_label", "first");
+  const char *before;
+  uint64_t uint_value = 0;
+  int64_t int_value = 0;
+
+  CHECK(snapshot.get_uint("snap_count", &uint_value));
+  CHECK(uint_value == 42);
+  CHECK(snapshot.get_int("snap_offset", &int_value));
+  CHECK(int_value == -3);
+  CHECK(!snapshot.get_uint("snap_label", &uint_value));
+  CHECK(snapshot.get_string("snap_missing") == NULL);
+
+  /* A write is seen by the next read, what was handed out stays valid. */
+  before = snapshot.get_string("snap_label");
+  CHECK(same(before, "first"));
+  label = "second";
+  CHECK(same(snapshot.get_string("snap_label"), "second"));
+  CHECK(same(before, "first"));
+  /* The same value is interned once. */
+  label = "first";
+  CHECK(snapshot.get_string("snap_label") == before);
+
+  count = 7;
+  CHECK(snapshot.get_uint("snap_count", &uint_value));
+  CHECK(uint_value == 7);
+}
+
+static void test_prefix(param_snapshot& snapshot)
+{
+  gs::gs_param<uint64_t> a("list_a", 1);
+  gs::gs_param<uint64_t> b("list_b", 2);
+  gs::gs_param<uint64_t> c("list_c", 3);
+  gs::gs_param<uint64_t> other("lisp", 4);
+  const char *names[2];
+  const char *values[2];
+  std::vector<std::string> all = snapshot.names();
+
+  /* Every match is counted, only max are returned. */
+  CHECK(snapshot.get_all("list_", names, values, 2) == 3);
+  CHECK((same(names[0], "list_a") && same(values[0], "1"))
+        || (same(names[0], "list_b") && same(values[0], "2"))
+        || (same(names[0], "list_c") && same(values[0], "3")));
+  CHECK(snapshot.get_all("lis", names, values, 0) == 4);
+  CHECK(snapshot.get_all("none_", names, values, 2) == 0);
+
+  CHECK(std::find(all.begin(), all.end(), "lisp") != all.end());
+}
+
+static void test_destroyed(param_snapshot& snapshot)
+{
+  gs::gs_param<uint64_t> *par = new gs::gs_param<uint64_t>("gone", 1);
+  uint64_t value = 0;
+
+  CHECK(snapshot.get_uint("gone", &value) && value == 1);
+  delete par;
+  CHECK(!snapshot.get_uint("gone", &value));
+  CHECK(snapshot.get_string("gone") == NULL);
+
+  par = new gs::gs_param<uint64_t>("gone", 2);
+  CHECK(snapshot.get_uint("gone", &value) && value == 2);
+  delete par;
+}
+
+int sc_main(int argc, char *argv[])
+{
+  gs::ctr::GC_Core core;
+  gs::cnf::ConfigDatabase database("ConfigDatabase");
+  gs::cnf::ConfigPlugin plugin(&database);
+  gs::gs_param<uint64_t> early("snap_early", 5);
+  param_snapshot snapshot;
+  uint64_t value = 0;
+
+  /* Nothing is answered before enable(). */
+  CHECK(!snapshot.get_uint("snap_early", &value));
+  snapshot.enable();
+  CHECK(snapshot.get_uint("snap_early", &value) && value == 5);
+
+  test_values(snapshot);
+  test_prefix(snapshot);
+  test_destroyed(snapshot);
+  return test_result();
+}
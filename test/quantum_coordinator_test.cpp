@@ -0,0 +1,168 @@
+/*
+ * quantum_coordinator_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * quantum_coordinator: CPUs joining by group, and the barrier releasing every
+ * CPU of a group together once all of them finished their quantum.
+ */
+
+#include <systemc.h>
+#include "SimpleCPU/quantum_coordinator.h"
+#include "test_check.h"
+
+#include <pthread.h>
+
+/*
+ * A CPU thread which does nothing but finish its quanta. It runs the first one
+ * as soon as it starts, like SimpleCPU does.
+ */
+class test_member:
+  public quantum_member
+{
+  public:
+  test_member():
+    coordinator(NULL),
+    quanta(0),
+    starts(0),
+    lockstep(true),
+    stopping(false)
+  {
+
+  }
+
+  void join(const std::string& group, uint64_t quantum_ns)
+  {
+    coordinator = quantum_coordinator::join(group, this, quantum_ns,
+                                            WAIT_BLOCK, 0);
+    pthread_create(&thread, NULL, cpu_thread, this);
+  }
+
+  void stop()
+  {
+    stopping = true;
+    go.post();
+    pthread_join(thread, NULL);
+  }
+
+  void wait_for_start()
+  {
+    started.wait();
+  }
+
+  bool io_pending()
+  {
+    return false;
+  }
+
+  void start_quantum()
+  {
+    /* Released only once the quantum before was finished. */
+    starts++;
+    lockstep &= __atomic_load_n(&quanta, __ATOMIC_SEQ_CST) == starts;
+    go.post();
+  }
+
+  quantum_coordinator *coordinator;
+  uint64_t quanta;                    /*<! Finished by the CPU thread. */
+  uint64_t starts;
+  bool lockstep;
+
+  private:
+  pthread_t thread;
+  sync_semaphore started;
+  sync_semaphore go;
+  volatile bool stopping;
+
+  static void *cpu_thread(void *opaque)
+  {
+    test_member *_this = (test_member *)opaque;
+
+    _this->started.post();
+    while (true)
+    {
+      __atomic_add_fetch(&_this->quanta, 1, __ATOMIC_SEQ_CST);
+      _this->coordinator->cpu_finished();
+      _this->go.wait();
+      if (_this->stopping)
+      {
+        break;
+      }
+    }
+    return NULL;
+  }
+};
+
+int sc_main(int argc, char *argv[])
+{
+  test_member a0, a1, b0;
+
+  /* The first CPU of a group sets its quantum. */
+  a0.join("a", 1000);
+  a1.join("a", 5000);
+  b0.join("b", 3000);
+  CHECK(a0.coordinator == a1.coordinator);
+  CHECK(a0.coordinator != b0.coordinator);
+  CHECK(a1.coordinator->get_quantum() == 1000);
+  CHECK(b0.coordinator->get_quantum() == 3000);
+
+  sc_core::sc_start(sc_core::sc_time(10500, sc_core::SC_NS));
+
+  /* One barrier per quantum, the CPUs of a group always together. */
+  CHECK(a0.starts == 10);
+  CHECK(a1.starts == 10);
+  CHECK(b0.starts == 3);
+  CHECK(a0.lockstep && a1.lockstep && b0.lockstep);
+
+  a0.stop();
+  a1.stop();
+  b0.stop();
+
+  /* The coordinator stays while a member is left. */
+  a0.coordinator->leave(&a0);
+  CHECK(quantum_coordinator::join("a", &a0, 2000, WAIT_BLOCK, 0)
+        == a1.coordinator);
+  a0.coordinator->leave(&a0);
+  a1.coordinator->leave(&a1);
+  b0.coordinator->leave(&b0);
+  return test_result();
+}
@@ -0,0 +1,181 @@
+/*
+ * register_backend_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * register_backend: write combining only inside the declared ranges, and the
+ * mmap backend against an anonymous shared mapping.
+ */
+
+#include "SimpleCPU/register_backend.h"
+#include "test_check.h"
+
+#include <sstream>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Keeps the raw accesses so the widths the device sees can be checked. */
+class counting_backend:
+  public register_backend
+{
+  public:
+  counting_backend(size_t combine_bytes):
+    register_backend(combine_bytes)
+  {
+
+  }
+  std::vector<uint64_t> addresses;
+  std::vector<size_t> widths;
+
+  protected:
+  int raw_write(uint64_t address, const uint8_t *data, size_t len)
+  {
+    addresses.push_back(address);
+    widths.push_back(len);
+    return 0;
+  }
+  int raw_read(uint64_t address, uint8_t *data, size_t len)
+  {
+    memset(data, 0, len);
+    return 0;
+  }
+};
+
+static void test_combine_opt_in()
+{
+  counting_backend backend(16);
+  uint32_t value = 0x12345678;
+
+  /* No range declared: every write goes out as it comes. */
+  CHECK(backend.write(0x100, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.write(0x104, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.widths.size() == 2);
+  CHECK(backend.widths[0] == 4 && backend.widths[1] == 4);
+
+  /* Inside a range: gathered into one 8 bytes access. */
+  backend.add_combine_range(0x1000, 0x1fff);
+  backend.addresses.clear();
+  backend.widths.clear();
+  CHECK(backend.write(0x1000, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.write(0x1004, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.widths.empty());
+  CHECK(backend.flush() == 0);
+  CHECK(backend.widths.size() == 1);
+  CHECK(backend.addresses[0] == 0x1000 && backend.widths[0] == 8);
+
+  /* A write outside the range lands after the ones held before it. */
+  backend.addresses.clear();
+  backend.widths.clear();
+  CHECK(backend.write(0x1000, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.write(0x2000, (uint8_t *)&value, 4) == 0);
+  CHECK(backend.addresses.size() == 2);
+  CHECK(backend.addresses[0] == 0x1000 && backend.addresses[1] == 0x2000);
+
+  /* Straddling the end of the range isn't combined. */
+  backend.addresses.clear();
+  backend.widths.clear();
+  CHECK(backend.write(0x1ffc, (uint8_t *)&value, 8) == 0);
+  CHECK(backend.widths.size() == 2);
+}
+
+static void test_mmap_backend()
+{
+  const size_t size = 4096;
+  const uint64_t base = 0x40000000;
+  int fd = syscall(SYS_memfd_create, "register_backend_test", 0);
+  std::ostringstream path_stream;
+  std::string path;
+  volatile uint8_t *device;
+  uint64_t value = 0x1122334455667788ULL;
+  uint64_t read_back = 0;
+
+  CHECK(fd >= 0);
+  if (fd < 0)
+  {
+    return;
+  }
+  CHECK(ftruncate(fd, size) == 0);
+  device = (volatile uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED, fd, 0);
+  CHECK(device != MAP_FAILED);
+  path_stream << "/proc/self/fd/" << fd;
+  path = path_stream.str();
+
+  {
+    mmap_register_backend backend(path, base, size, 16);
+
+    CHECK(backend.is_mapped());
+    backend.add_combine_range(base + 0x100, base + 0x1ff);
+
+    /* Not combined: visible at once. */
+    CHECK(backend.write(base + 0x10, (uint8_t *)&value, 4) == 0);
+    CHECK(*(volatile uint32_t *)(device + 0x10) == 0x55667788);
+
+    /* Combined: held until a read of the window. */
+    CHECK(backend.write(base + 0x100, (uint8_t *)&value, 8) == 0);
+    CHECK(*(volatile uint64_t *)(device + 0x100) == 0);
+    CHECK(backend.read(base + 0x100, (uint8_t *)&read_back, 8) == 0);
+    CHECK(read_back == value);
+    CHECK(*(volatile uint64_t *)(device + 0x100) == value);
+
+    /* Unaligned: split into naturally aligned accesses. */
+    CHECK(backend.write(base + 0x21, (uint8_t *)&value, 7) == 0);
+    CHECK(memcmp((const void *)(device + 0x21), &value, 7) == 0);
+
+    /* Outside the window. */
+    CHECK(backend.write(base + size, (uint8_t *)&value, 4) != 0);
+    CHECK(backend.read(base - 4, (uint8_t *)&read_back, 4) != 0);
+  }
+
+  munmap((void *)device, size);
+  close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+  test_combine_opt_in();
+  test_mmap_backend();
+  return test_result();
+}
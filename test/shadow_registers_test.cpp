@@ -0,0 +1,157 @@
+/*
+ * shadow_registers_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * shadow_registers: range validation, the three modes, invalidation and the
+ * order the held writes come back in.
+ */
+
+#include "SimpleCPU/shadow_registers.h"
+#include "test_check.h"
+
+#include <string.h>
+
+static void test_ranges()
+{
+  shadow_registers shadow;
+
+  CHECK(shadow.empty());
+  CHECK(shadow.add_range(0x1000, 0x10ff, SHADOW_READ));
+  CHECK(shadow.add_range(0x2000, 0x20ff, SHADOW_READ));
+  CHECK(!shadow.empty());
+
+  /* Overlapping either neighbour, or inside one. */
+  CHECK(!shadow.add_range(0x0f00, 0x1000, SHADOW_READ));
+  CHECK(!shadow.add_range(0x10ff, 0x1fff, SHADOW_READ));
+  CHECK(!shadow.add_range(0x1f00, 0x2000, SHADOW_READ));
+  CHECK(!shadow.add_range(0x1010, 0x1020, SHADOW_READ));
+  /* Adjacent is fine. */
+  CHECK(shadow.add_range(0x1100, 0x1fff, SHADOW_READ));
+
+  /* Too large, or backwards. */
+  CHECK(!shadow.add_range(0x100000, 0x100000 + shadow_registers::max_range_size,
+                          SHADOW_READ));
+  CHECK(!shadow.add_range(0x3000, 0x2fff, SHADOW_READ));
+}
+
+static void test_read_mode()
+{
+  shadow_registers shadow;
+  uint32_t value = 0x12345678;
+  uint32_t read_back = 0;
+
+  CHECK(shadow.add_range(0x1000, 0x10ff, SHADOW_READ));
+
+  /* Nothing known before a fill. */
+  CHECK(!shadow.read(0x1000, (uint8_t *)&read_back, 4));
+  shadow.fill(0x1000, (uint8_t *)&value, 4);
+  CHECK(shadow.read(0x1000, (uint8_t *)&read_back, 4));
+  CHECK(read_back == value);
+  /* Partly known, or straddling the end of the range. */
+  CHECK(!shadow.read(0x1002, (uint8_t *)&read_back, 4));
+  CHECK(!shadow.read(0x10fe, (uint8_t *)&read_back, 4));
+
+  /* A write goes to the target and forgets the copy. */
+  CHECK(!shadow.write(0x1000, (uint8_t *)&value, 4));
+  CHECK(!shadow.read(0x1000, (uint8_t *)&read_back, 4));
+  CHECK(!shadow.is_dirty());
+
+  shadow.fill(0x1000, (uint8_t *)&value, 4);
+  shadow.invalidate(0x1003, 0x1003);
+  CHECK(!shadow.read(0x1000, (uint8_t *)&read_back, 4));
+  CHECK(shadow.read(0x1000, (uint8_t *)&read_back, 2));
+}
+
+static void test_write_modes()
+{
+  shadow_registers shadow;
+  std::vector<shadow_write> writes;
+  uint32_t first = 0x11111111;
+  uint32_t second = 0x22222222;
+  uint32_t third = 0x33333333;
+  uint32_t read_back = 0;
+
+  CHECK(shadow.add_range(0x1000, 0x10ff, SHADOW_WRITE_THROUGH));
+  CHECK(shadow.add_range(0x2000, 0x20ff, SHADOW_WRITE_BACK));
+
+  /* Write-through: sent to the target, and readable at once. */
+  CHECK(!shadow.write(0x1000, (uint8_t *)&first, 4));
+  CHECK(shadow.read(0x1000, (uint8_t *)&read_back, 4));
+  CHECK(read_back == first);
+  CHECK(!shadow.is_dirty());
+
+  /* Write-back: held, the last value of a register is flushed once. */
+  CHECK(shadow.write(0x2000, (uint8_t *)&first, 4));
+  CHECK(shadow.write(0x2008, (uint8_t *)&second, 4));
+  CHECK(shadow.write(0x2000, (uint8_t *)&third, 4));
+  CHECK(shadow.is_dirty());
+  CHECK(shadow.read(0x2000, (uint8_t *)&read_back, 4));
+  CHECK(read_back == third);
+
+  /* A target change doesn't drop a write not flushed yet. */
+  shadow.invalidate(0x2000, 0x20ff);
+  CHECK(shadow.read(0x2000, (uint8_t *)&read_back, 4));
+
+  shadow.take_dirty(writes);
+  CHECK(!shadow.is_dirty());
+  CHECK(writes.size() == 2);
+  if (writes.size() == 2)
+  {
+    CHECK(writes[0].address == 0x2000 && writes[0].size == 4);
+    CHECK(!memcmp(writes[0].data, &third, 4));
+    CHECK(writes[1].address == 0x2008 && writes[1].size == 4);
+    CHECK(!memcmp(writes[1].data, &second, 4));
+  }
+
+  /* Once flushed, a target change applies again. */
+  shadow.invalidate(0x2000, 0x20ff);
+  CHECK(!shadow.read(0x2000, (uint8_t *)&read_back, 4));
+}
+
+int main(int argc, char *argv[])
+{
+  test_ranges();
+  test_read_mode();
+  test_write_modes();
+  return test_result();
+}
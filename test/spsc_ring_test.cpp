@@ -0,0 +1,134 @@
+/*
+ * spsc_ring_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * spsc_ring: order and wrap-around on one thread, then a producer and a
+ * consumer thread passing a sequence through a small ring.
+ */
+
+#include "SimpleCPU/spsc_ring.h"
+#include "test_check.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+static const uint64_t sequence_length = 1000000;
+static spsc_ring<uint64_t, 8> shared_ring;
+
+static void test_single_thread()
+{
+  spsc_ring<uint32_t, 4> ring;
+  uint32_t value;
+
+  CHECK(ring.empty());
+  CHECK(!ring.pop(value));
+  CHECK((spsc_ring<uint32_t, 4>::capacity() == 4));
+
+  /* Full after capacity() pushes, the next one fails. */
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    CHECK(ring.push(i));
+  }
+  CHECK(ring.count() == 4);
+  CHECK(!ring.push(4));
+
+  /* Several laps: the order is kept across the wrap-around. */
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    CHECK(ring.pop(value));
+    CHECK(value == i);
+    CHECK(ring.push(i + 4));
+  }
+  CHECK(ring.count() == 4);
+
+  /* peek() leaves the item in place until release(). */
+  CHECK(ring.peek() && *ring.peek() == 20);
+  CHECK(ring.count() == 4);
+  ring.release();
+  CHECK(ring.count() == 3);
+}
+
+static void *producer(void *opaque)
+{
+  for (uint64_t i = 0; i < sequence_length; i++)
+  {
+    while (!shared_ring.push(i))
+    {
+      /* Full: let the consumer catch up, even on a single CPU. */
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void test_two_threads()
+{
+  pthread_t thread;
+  uint64_t expected = 0;
+  bool ordered = true;
+  uint64_t value;
+
+  CHECK(pthread_create(&thread, NULL, producer, NULL) == 0);
+  /* Keep draining on a mismatch, or the producer never finishes. */
+  for (uint64_t received = 0; received < sequence_length;)
+  {
+    if (!shared_ring.pop(value))
+    {
+      sched_yield();
+      continue;
+    }
+    ordered = ordered && (value == expected);
+    expected++;
+    received++;
+  }
+  pthread_join(thread, NULL);
+  CHECK(ordered);
+  CHECK(shared_ring.empty());
+}
+
+int main(int argc, char *argv[])
+{
+  test_single_thread();
+  test_two_threads();
+  return test_result();
+}
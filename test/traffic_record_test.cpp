@@ -0,0 +1,222 @@
+/*
+ * traffic_record_test.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * traffic_record: what traffic_recorder writes comes back from traffic_reader
+ * unchanged, bursts included, a truncated recording stops at its last
+ * complete record and failed writes are reported by close().
+ */
+
+#include "SimpleCPU/traffic_record.h"
+#include "test_check.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static std::string temporary_path()
+{
+  char path[] = "/tmp/traffic_record_testXXXXXX";
+  int fd = mkstemp(path);
+
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  return path;
+}
+
+static traffic_record make_record(traffic_record_kind kind, uint64_t address,
+                                  uint64_t value, uint32_t size)
+{
+  traffic_record record;
+
+  memset(&record, 0, sizeof(record));
+  record.sc_ps = address * 1000;
+  record.address = address;
+  record.value = value;
+  record.size = size;
+  record.kind = kind;
+  return record;
+}
+
+/* Every kind of record and a burst of a size which needs padding. */
+static void write_recording(const std::string& path, const uint8_t *burst,
+                            uint32_t burst_size)
+{
+  traffic_recorder recorder;
+  traffic_record record;
+
+  CHECK(recorder.open(path, 10000));
+  record = make_record(TRAFFIC_WRITE, 0x100, 0x12345678, 4);
+  record.route = TRAFFIC_ROUTE_SHADOW;
+  recorder.record(record, NULL);
+  record = make_record(TRAFFIC_WRITE, 0x200, 0, burst_size);
+  record.flags = TRAFFIC_FLAG_POSTED | TRAFFIC_FLAG_STATUS_UNKNOWN;
+  recorder.record(record, burst);
+  record = make_record(TRAFFIC_READ, 0x300, 0xCAFE, 2);
+  record.status = 1;
+  recorder.record(record, NULL);
+  recorder.record(make_record(TRAFFIC_IRQ, 5, 1, 0), NULL);
+  recorder.record(make_record(TRAFFIC_QUANTUM, 0, 20000, 0), NULL);
+  CHECK(recorder.get_count() == 5);
+  CHECK(recorder.close());
+  CHECK(recorder.get_write_errors() == 0);
+
+  /* Closed: late records are ignored. */
+  recorder.record(make_record(TRAFFIC_IRQ, 6, 0, 0), NULL);
+  CHECK(recorder.get_count() == 5);
+}
+
+static void test_round_trip()
+{
+  std::string path = temporary_path();
+  traffic_reader reader;
+  traffic_record record;
+  const uint8_t *data;
+  uint8_t burst[13];
+
+  for (size_t i = 0; i < sizeof(burst); i++)
+  {
+    burst[i] = 0xA0 + i;
+  }
+  write_recording(path, burst, sizeof(burst));
+
+  CHECK(reader.open(path));
+  CHECK(reader.header().quantum_ns == 10000);
+
+  CHECK(reader.next(&record, &data));
+  CHECK(record.kind == TRAFFIC_WRITE && record.address == 0x100);
+  CHECK(record.value == 0x12345678 && record.size == 4 && data == NULL);
+  CHECK(record.route == TRAFFIC_ROUTE_SHADOW && record.sc_ps == 0x100 * 1000);
+
+  CHECK(reader.next(&record, &data));
+  CHECK(record.kind == TRAFFIC_WRITE && record.size == sizeof(burst));
+  CHECK(record.flags == (TRAFFIC_FLAG_POSTED | TRAFFIC_FLAG_STATUS_UNKNOWN));
+  CHECK(data && !memcmp(data, burst, sizeof(burst)));
+
+  /* The padding after the burst was skipped. */
+  CHECK(reader.next(&record, &data));
+  CHECK(record.kind == TRAFFIC_READ && record.address == 0x300);
+  CHECK(record.value == 0xCAFE && record.status == 1 && data == NULL);
+
+  CHECK(reader.next(&record, &data));
+  CHECK(record.kind == TRAFFIC_IRQ && record.address == 5 && record.value == 1);
+  CHECK(reader.next(&record, &data));
+  CHECK(record.kind == TRAFFIC_QUANTUM && record.value == 20000);
+  CHECK(!reader.next(&record, &data));
+  unlink(path.c_str());
+}
+
+static void test_truncated()
+{
+  std::string path = temporary_path();
+  traffic_reader reader;
+  traffic_record record;
+  const uint8_t *data;
+  uint8_t burst[64];
+  FILE *file;
+  long size;
+
+  /* Cut in the middle of the burst: only the record before it is read. */
+  memset(burst, 0x5A, sizeof(burst));
+  write_recording(path, burst, sizeof(burst));
+  file = fopen(path.c_str(), "rb");
+  CHECK(file != NULL);
+  if (!file)
+  {
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fclose(file);
+  CHECK(truncate(path.c_str(), size - 3 * sizeof(traffic_record) - 32) == 0);
+
+  CHECK(reader.open(path));
+  CHECK(reader.next(&record, &data));
+  CHECK(record.address == 0x100);
+  CHECK(!reader.next(&record, &data));
+  unlink(path.c_str());
+}
+
+static void test_bad_file()
+{
+  std::string path = temporary_path();
+  traffic_reader reader;
+  FILE *file = fopen(path.c_str(), "wb");
+
+  CHECK(file != NULL);
+  if (!file)
+  {
+    return;
+  }
+  fputs("not a recording, not a recording, not a recording", file);
+  fclose(file);
+  CHECK(!reader.open(path));
+  CHECK(!reader.open("/nonexistent/traffic"));
+  unlink(path.c_str());
+}
+
+static void test_write_errors()
+{
+  traffic_recorder recorder;
+
+  /* Every write to /dev/full fails: the final flush at least. */
+  if (access("/dev/full", W_OK))
+  {
+    return;
+  }
+  CHECK(recorder.open("/dev/full", 1000));
+  recorder.record(make_record(TRAFFIC_READ, 0x100, 0, 4), NULL);
+  CHECK(!recorder.close());
+  CHECK(recorder.get_write_errors() > 0);
+}
+
+int main(int argc, char *argv[])
+{
+  test_round_trip();
+  test_truncated();
+  test_bad_file();
+  test_write_errors();
+  return test_result();
+}
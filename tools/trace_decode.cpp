@@ -0,0 +1,120 @@
+/*
+ * trace_decode.cpp
+ *
+ * Copyright (C) 2014, GreenSocs Ltd.
+ *
+ * Developped by Konrad Frederic <fred.konrad@greensocs.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses>.
+ *
+ * Linking GreenSocs code, statically or dynamically with other modules
+ * is making a combined work based on GreenSocs code. Thus, the terms and
+ * conditions of the GNU General Public License cover the whole
+ * combination.
+ *
+ * In addition, as a special exception, the copyright holders, GreenSocs
+ * Ltd, give you permission to combine GreenSocs code with free software
+ * programs or libraries that are released under the GNU LGPL, under the
+ * OSCI license, under the OCP TLM Kit Research License Agreement or
+ * under the OVP evaluation license.You may copy and distribute such a
+ * system following the terms of the GNU GPL and the licenses of the
+ * other code concerned.
+ *
+ * Note that people who make modified versions of GreenSocs code are not
+ * obligated to grant this special exception for their modified versions;
+ * it is their choice whether to do so. The GNU General Public License
+ * gives permission to release a modified version without this exception;
+ * this exception also makes it possible to release a modified version
+ * which carries forward this exception.
+ *
+ */
+
+
+/*
+ * Turn a binary register access trace back into the text format of the old
+ * performance.log:
+ *   trace_decode [--full] trace.bin
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <iomanip>
+#include <iostream>
+#include "SimpleCPU/access_trace_format.h"
+
+int main(int argc, char *argv[])
+{
+  access_trace_header header;
+  access_trace_record record;
+  const char *path = NULL;
+  bool full = false;
+  FILE *file;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--full"))
+    {
+      full = true;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  if (!path)
+  {
+    std::cerr << "usage: " << argv[0] << " [--full] trace" << std::endl;
+    return 1;
+  }
+
+  file = fopen(path, "rb");
+  if (!file)
+  {
+    std::cerr << "can't open " << path << std::endl;
+    return 1;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1
+      || strncmp(header.magic, ACCESS_TRACE_MAGIC, sizeof(header.magic))
+      || header.version != ACCESS_TRACE_VERSION
+      || header.record_size != sizeof(record))
+  {
+    std::cerr << path << " is not a SimpleCPU access trace" << std::endl;
+    fclose(file);
+    return 1;
+  }
+
+  while (fread(&record, sizeof(record), 1, file) == 1)
+  {
+    double seconds = (double)(record.host_ns - header.host_start_ns) / 1e9;
+
+    std::cout << "[ " << std::setprecision(10) << seconds << " s ] "
+              << "CPU: iswrite=" << (int)record.is_write
+              << (record.is_write ? " Write" : " Read")
+              << " addr=0x" << std::hex << record.address
+              << "  data=0x" << record.value << std::dec;
+    if (full)
+    {
+      std::cout << " size=" << record.size
+                << " sc_time=" << record.sc_ps << "ps"
+                << " latency=" << record.latency_ns << "ns"
+                << (record.posted ? " posted" : "");
+    }
+    std::cout << std::endl;
+  }
+
+  fclose(file);
+  return 0;
+}